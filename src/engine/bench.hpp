@@ -0,0 +1,23 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstddef>
+#include "types.hpp"
+
+namespace engine
+{
+    constexpr Depth DEFAULT_BENCH_DEPTH = 10;
+    constexpr size_t DEFAULT_BENCH_HASH_MB = 16;
+
+    /**
+     * Search a fixed set of positions to a fixed depth, each one from an
+     * empty hash and empty history, and print the total nodes and the nps.
+     * With a single thread the total is a signature of the search: a change
+     * that keeps it is functionally identical. With more threads the total
+     * depends on the timing of the threads.
+     */
+    void runBench(Depth depth = DEFAULT_BENCH_DEPTH, int threads = 1,
+                  size_t hashMegabytes = DEFAULT_BENCH_HASH_MB);
+}
+
+#endif
@@ -0,0 +1,549 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "bitbase.hpp"
+#include "bitboard.hpp"
+#include "memory.hpp"
+
+namespace engine
+{
+    struct BitbaseInfo
+    {
+        PieceType pieces[2];
+        int pieceCount;
+        bool pawns;
+    };
+
+    static const BitbaseInfo bitbaseInfos[BITBASE_COUNT] = {
+        {{PAWN, NULL_TYPE}, 1, true},
+        {{ROOK, NULL_TYPE}, 1, false},
+        {{QUEEN, NULL_TYPE}, 1, false},
+        {{BISHOP, KNIGHT}, 2, false},
+    };
+
+    // a position of a table, where the strong side is white
+    struct BitbasePosition
+    {
+        int weakToMove;
+        Tile strongKing;
+        Tile weakKing;
+        Tile pieces[2];
+    };
+
+    struct BitbaseFileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t tableCount;
+        uint64_t offsets[BITBASE_COUNT];
+        uint64_t sizes[BITBASE_COUNT];
+    };
+
+    // marks the positions of the weak side that are never lost: illegal
+    // positions, stalemates and positions where it takes a piece
+    constexpr uint8_t NEVER_LOST = 0xff;
+
+    static std::vector<uint8_t> generated[BITBASE_COUNT];
+    static MappedFile mappedFile;
+    static const uint8_t *tables[BITBASE_COUNT] = {};
+
+    // the strong king is on the files a-d, and also on the ranks 1-4 without pawns
+    static size_t getKingDomain(BitbaseId id)
+    {
+        return bitbaseInfos[id].pawns ? 32 : 16;
+    }
+
+    static size_t getEntryCount(BitbaseId id)
+    {
+        size_t count = 2 * getKingDomain(id) * 64;
+        for (int i = 0; i < bitbaseInfos[id].pieceCount; i++)
+        {
+            count *= 64;
+        }
+        return count;
+    }
+
+    static void flip(BitbasePosition &p, int mask)
+    {
+        p.strongKing = Tile(p.strongKing ^ mask);
+        p.weakKing = Tile(p.weakKing ^ mask);
+        p.pieces[0] = Tile(p.pieces[0] ^ mask);
+        p.pieces[1] = Tile(p.pieces[1] ^ mask);
+    }
+
+    static void normalize(BitbaseId id, BitbasePosition &p)
+    {
+        if (fileOf(p.strongKing) > FILE_D)
+            flip(p, 7);
+        if (!bitbaseInfos[id].pawns && rankOf(p.strongKing) > RANK_4)
+            flip(p, 56);
+    }
+
+    static size_t getIndex(BitbaseId id, const BitbasePosition &p)
+    {
+        size_t index = p.weakToMove;
+        index = index * getKingDomain(id) + rankOf(p.strongKing) * 4 + fileOf(p.strongKing);
+        index = index * 64 + p.weakKing;
+        for (int i = 0; i < bitbaseInfos[id].pieceCount; i++)
+        {
+            index = index * 64 + p.pieces[i];
+        }
+        return index;
+    }
+
+    static BitbasePosition decode(BitbaseId id, size_t index)
+    {
+        BitbasePosition p;
+        p.pieces[0] = p.pieces[1] = A1;
+        for (int i = bitbaseInfos[id].pieceCount - 1; i >= 0; i--)
+        {
+            p.pieces[i] = Tile(index % 64);
+            index /= 64;
+        }
+        p.weakKing = Tile(index % 64);
+        index /= 64;
+        size_t king = index % getKingDomain(id);
+        p.strongKing = makeTile(File(king % 4), Rank(king / 4));
+        p.weakToMove = index / getKingDomain(id);
+        return p;
+    }
+
+    static Bitboard getPiecesBB(BitbaseId id, const BitbasePosition &p)
+    {
+        Bitboard pieces = 0;
+        for (int i = 0; i < bitbaseInfos[id].pieceCount; i++)
+        {
+            pieces |= tileBB(p.pieces[i]);
+        }
+        return pieces;
+    }
+
+    // tiles attacked by the pieces of the strong side, its king excluded
+    static Bitboard getPieceAttacks(BitbaseId id, const BitbasePosition &p, Bitboard occupied)
+    {
+        Bitboard attacks = 0;
+        for (int i = 0; i < bitbaseInfos[id].pieceCount; i++)
+        {
+            PieceType pt = bitbaseInfos[id].pieces[i];
+            attacks |= pt == PAWN ? pawnAttacks[WHITE][p.pieces[i]]
+                                  : getAttacksBB(pt, p.pieces[i], occupied);
+        }
+        return attacks;
+    }
+
+    static bool isLegal(BitbaseId id, const BitbasePosition &p)
+    {
+        Bitboard occupied = tileBB(p.strongKing) | tileBB(p.weakKing);
+        if (p.strongKing == p.weakKing || (getAttacksBB<KING>(p.strongKing) & tileBB(p.weakKing)))
+            return false;
+
+        for (int i = 0; i < bitbaseInfos[id].pieceCount; i++)
+        {
+            if (occupied & tileBB(p.pieces[i]))
+                return false;
+            if (bitbaseInfos[id].pawns && (rankOf(p.pieces[i]) == RANK_1 || rankOf(p.pieces[i]) == RANK_8))
+                return false;
+            occupied |= tileBB(p.pieces[i]);
+        }
+
+        // the side that has just moved can't be in check
+        return p.weakToMove || !(getPieceAttacks(id, p, occupied) & tileBB(p.weakKing));
+    }
+
+    static bool getBit(const uint8_t *bits, size_t index)
+    {
+        return bits[index / 8] >> (index % 8) & 1;
+    }
+
+    // Return true if the bit was not set yet
+    static bool setBit(uint8_t *bits, size_t index)
+    {
+        uint8_t mask = 1 << (index % 8);
+        return !(std::atomic_ref<uint8_t>(bits[index / 8]).fetch_or(mask, std::memory_order_relaxed) & mask);
+    }
+
+    // Split [0, count) in one chunk per thread
+    static void runParallel(int threads, size_t count, const std::function<void(int, size_t, size_t)> &work)
+    {
+        size_t chunkSize = (count + threads - 1) / threads;
+        std::vector<std::thread> helpers;
+        for (int i = threads - 1; i >= 0; i--)
+        {
+            size_t begin = std::min(i * chunkSize, count);
+            size_t end = std::min(begin + chunkSize, count);
+            if (i == 0)
+                work(i, begin, end);
+            else
+                helpers.emplace_back(work, i, begin, end);
+        }
+        for (auto &helper : helpers)
+        {
+            helper.join();
+        }
+    }
+
+    // Count the moves of the weak side, which wins when they all lead to a
+    // win, and mark the mates. With the strong side to move, a promotion
+    // into a won position is a win
+    static void initPosition(BitbaseId id, size_t index, uint8_t *bits, uint8_t *counts,
+                             std::vector<uint32_t> &won)
+    {
+        BitbasePosition p = decode(id, index);
+        counts[index] = NEVER_LOST;
+        if (!isLegal(id, p))
+            return;
+
+        Bitboard pieces = getPiecesBB(id, p);
+        Bitboard occupied = pieces | tileBB(p.strongKing) | tileBB(p.weakKing);
+
+        if (p.weakToMove)
+        {
+            // the weak king doesn't block the lines through its own tile
+            Bitboard attacked = getAttacksBB<KING>(p.strongKing) |
+                                getPieceAttacks(id, p, occupied ^ tileBB(p.weakKing));
+            Bitboard moves = getAttacksBB<KING>(p.weakKing) & ~attacked;
+
+            // taking a piece leaves a draw
+            if (moves & pieces)
+                return;
+            if (moves)
+                counts[index] = __builtin_popcountll(moves);
+            else if ((attacked & tileBB(p.weakKing)) && setBit(bits, index))
+                won.push_back(index);
+            return;
+        }
+
+        Tile pawn = p.pieces[0];
+        if (id == KPK && rankOf(pawn) == RANK_7 && !(occupied & tileBB(pawn + UP)))
+        {
+            for (BitbaseId promoted : {KQK, KRK})
+            {
+                BitbasePosition next = p;
+                next.pieces[0] = pawn + UP;
+                next.weakToMove = 1;
+                normalize(promoted, next);
+                if (isLegal(promoted, next) && getBit(tables[promoted], getIndex(promoted, next)) &&
+                    setBit(bits, index))
+                {
+                    won.push_back(index);
+                }
+            }
+        }
+    }
+
+    // Go back one move from a won position: every move of the strong side
+    // into it wins, a move of the weak side into it takes one of its escapes
+    static void retract(BitbaseId id, size_t index, uint8_t *bits, uint8_t *counts,
+                        std::vector<uint32_t> &won)
+    {
+        BitbasePosition p = decode(id, index);
+        Bitboard occupied = getPiecesBB(id, p) | tileBB(p.strongKing) | tileBB(p.weakKing);
+
+        if (!p.weakToMove)
+        {
+            Bitboard from = getAttacksBB<KING>(p.weakKing) & ~occupied;
+            while (from)
+            {
+                BitbasePosition previous = p;
+                previous.weakKing = popLsb(from);
+                previous.weakToMove = 1;
+                if (!isLegal(id, previous))
+                    continue;
+
+                normalize(id, previous);
+                size_t previousIndex = getIndex(id, previous);
+                if (counts[previousIndex] == NEVER_LOST || getBit(bits, previousIndex))
+                    continue;
+                if (std::atomic_ref<uint8_t>(counts[previousIndex]).fetch_sub(1, std::memory_order_relaxed) == 1 &&
+                    setBit(bits, previousIndex))
+                {
+                    won.push_back(previousIndex);
+                }
+            }
+            return;
+        }
+
+        auto tryPrevious = [&](BitbasePosition previous)
+        {
+            previous.weakToMove = 0;
+            if (!isLegal(id, previous))
+                return;
+            normalize(id, previous);
+            size_t previousIndex = getIndex(id, previous);
+            if (setBit(bits, previousIndex))
+                won.push_back(previousIndex);
+        };
+
+        Bitboard from = getAttacksBB<KING>(p.strongKing) & ~occupied;
+        while (from)
+        {
+            BitbasePosition previous = p;
+            previous.strongKing = popLsb(from);
+            tryPrevious(previous);
+        }
+
+        for (int i = 0; i < bitbaseInfos[id].pieceCount; i++)
+        {
+            PieceType pt = bitbaseInfos[id].pieces[i];
+            Tile to = p.pieces[i];
+            if (pt == PAWN)
+            {
+                // pawns on the second rank haven't moved yet
+                if (rankOf(to) < RANK_3 || (occupied & tileBB(to - UP)))
+                    continue;
+                from = tileBB(to - UP);
+                if (rankOf(to) == RANK_4 && !(occupied & tileBB(to - UP - UP)))
+                    from |= tileBB(to - UP - UP);
+            }
+            else
+            {
+                from = getAttacksBB(pt, to, occupied) & ~occupied;
+            }
+
+            while (from)
+            {
+                BitbasePosition previous = p;
+                previous.pieces[i] = popLsb(from);
+                tryPrevious(previous);
+            }
+        }
+    }
+
+    static void generateTable(BitbaseId id, int threads)
+    {
+        size_t entryCount = getEntryCount(id);
+        std::vector<uint8_t> bits((entryCount + 7) / 8, 0);
+        std::vector<uint8_t> counts(entryCount);
+        std::vector<std::vector<uint32_t>> won(threads);
+
+        runParallel(threads, entryCount, [&](int thread, size_t begin, size_t end)
+                    {
+                        for (size_t i = begin; i < end; i++)
+                            initPosition(id, i, bits.data(), counts.data(), won[thread]);
+                    });
+
+        // every round goes back one ply from the positions won in the previous one
+        std::vector<uint32_t> frontier;
+        while (true)
+        {
+            frontier.clear();
+            for (auto &positions : won)
+            {
+                frontier.insert(frontier.end(), positions.begin(), positions.end());
+                positions.clear();
+            }
+            if (frontier.empty())
+                break;
+
+            runParallel(threads, frontier.size(), [&](int thread, size_t begin, size_t end)
+                        {
+                            for (size_t i = begin; i < end; i++)
+                                retract(id, frontier[i], bits.data(), counts.data(), won[thread]);
+                        });
+        }
+
+        generated[id] = std::move(bits);
+        tables[id] = generated[id].data();
+    }
+
+    static int distance(Tile a, Tile b)
+    {
+        return std::max(std::abs(fileOf(a) - fileOf(b)), std::abs(rankOf(a) - rankOf(b)));
+    }
+
+    static int edgeDistance(Tile tile)
+    {
+        return std::min({(int)fileOf(tile), 7 - fileOf(tile), (int)rankOf(tile), 7 - rankOf(tile)});
+    }
+
+    // drive the weak king to the edge, or to a corner of the color of the
+    // bishop, with the strong king close to it, and push the pawn
+    static Eval getWinScore(BitbaseId id, const BitbasePosition &p)
+    {
+        Eval score = BITBASE_WIN;
+        for (int i = 0; i < bitbaseInfos[id].pieceCount; i++)
+        {
+            score += getPieceEval(bitbaseInfos[id].pieces[i]);
+        }
+
+        if (id == KPK)
+            return score + 20 * rankOf(p.pieces[0]);
+
+        score += 10 * (7 - distance(p.strongKing, p.weakKing));
+        if (id == KBNK)
+        {
+            bool darkBishop = ((int)fileOf(p.pieces[0]) + (int)rankOf(p.pieces[0])) % 2 == 0;
+            Tile corners[2] = {darkBishop ? A1 : H1, darkBishop ? H8 : A8};
+            return score + 20 * (7 - std::min(distance(p.weakKing, corners[0]), distance(p.weakKing, corners[1])));
+        }
+        return score + 20 * (3 - edgeDistance(p.weakKing));
+    }
+
+    void bitbase::generate(int threads, bool withKBNK)
+    {
+        threads = std::max(threads, 1);
+        // KPK promotes into the other two
+        for (BitbaseId id : {KQK, KRK, KPK, KBNK})
+        {
+            if (tables[id] == NULL && (id != KBNK || withKBNK))
+                generateTable(id, threads);
+        }
+    }
+
+    // The header is followed by the tables, each one aligned to a cache line
+    bool bitbase::save(const std::string &fileName)
+    {
+        BitbaseFileHeader header = {};
+        std::memcpy(header.magic, BITBASE_MAGIC, sizeof(header.magic));
+        header.version = BITBASE_VERSION;
+        header.tableCount = BITBASE_COUNT;
+
+        uint64_t offset = (sizeof(header) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        for (int id = 0; id < BITBASE_COUNT; id++)
+        {
+            if (tables[id] == NULL)
+                continue;
+            header.offsets[id] = offset;
+            header.sizes[id] = getTableBytes(BitbaseId(id));
+            offset += (header.sizes[id] + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        }
+
+        std::ofstream file(fileName, std::ios::binary);
+        if (!file)
+            return false;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (int id = 0; id < BITBASE_COUNT; id++)
+        {
+            if (tables[id] == NULL)
+                continue;
+            file.seekp(header.offsets[id]);
+            file.write(reinterpret_cast<const char *>(tables[id]), header.sizes[id]);
+        }
+        // pad the last table to its full size
+        file.seekp(0, std::ios::end);
+        while ((uint64_t)file.tellp() < offset)
+            file.put(0);
+        return (bool)file;
+    }
+
+    bool bitbase::load(const std::string &fileName)
+    {
+        clear();
+        if (!mappedFile.open(fileName))
+            return false;
+
+        BitbaseFileHeader header;
+        if (mappedFile.getSize() < sizeof(header))
+        {
+            mappedFile.close();
+            return false;
+        }
+        std::memcpy(&header, mappedFile.getData(), sizeof(header));
+        bool valid = std::memcmp(header.magic, BITBASE_MAGIC, sizeof(header.magic)) == 0 &&
+                     header.version == BITBASE_VERSION && header.tableCount == BITBASE_COUNT;
+        for (int id = 0; valid && id < BITBASE_COUNT; id++)
+        {
+            valid = header.sizes[id] == 0 ||
+                    (header.sizes[id] == getTableBytes(BitbaseId(id)) &&
+                     header.offsets[id] + header.sizes[id] <= mappedFile.getSize());
+        }
+        if (!valid)
+        {
+            mappedFile.close();
+            return false;
+        }
+
+        for (int id = 0; id < BITBASE_COUNT; id++)
+        {
+            if (header.sizes[id] > 0)
+                tables[id] = mappedFile.getData() + header.offsets[id];
+        }
+        return true;
+    }
+
+    void bitbase::clear()
+    {
+        for (int id = 0; id < BITBASE_COUNT; id++)
+        {
+            tables[id] = NULL;
+            generated[id].clear();
+            generated[id].shrink_to_fit();
+        }
+        mappedFile.close();
+    }
+
+    bool bitbase::isAvailable(BitbaseId id)
+    {
+        return tables[id] != NULL;
+    }
+
+    size_t bitbase::getTableBytes(BitbaseId id)
+    {
+        return (getEntryCount(id) + 7) / 8;
+    }
+
+    bool bitbase::probe(const Position &pos, Eval &score)
+    {
+        // most positions fail here, with pieces on both sides
+        Bitboard white = pos.getPieces(WHITE);
+        Bitboard black = pos.getPieces(BLACK);
+        if (moreThanOne(white) == moreThanOne(black))
+            return false;
+
+        Color strong = moreThanOne(white) ? WHITE : BLACK;
+        Bitboard extra = (strong == WHITE ? white : black) & ~pos.getPieces(KING);
+        if (moreThanOne(extra & (extra - 1)))
+            return false;
+
+        BitbaseId id;
+        BitbasePosition p;
+        if (!moreThanOne(extra))
+        {
+            p.pieces[0] = lsb(extra);
+            p.pieces[1] = A1;
+            PieceType pt = typeOf(pos.getPiece(p.pieces[0]));
+            if (pt == PAWN)
+                id = KPK;
+            else if (pt == ROOK)
+                id = KRK;
+            else if (pt == QUEEN)
+                id = KQK;
+            else
+                return false;
+        }
+        else
+        {
+            Bitboard bishops = extra & pos.getPieces(BISHOP);
+            Bitboard knights = extra & pos.getPieces(KNIGHT);
+            if (!bishops || !knights)
+                return false;
+            p.pieces[0] = lsb(bishops);
+            p.pieces[1] = lsb(knights);
+            id = KBNK;
+        }
+
+        if (tables[id] == NULL)
+            return false;
+
+        p.strongKing = lsb(pos.getPieces(KING, strong));
+        p.weakKing = lsb(pos.getPieces(KING, ~strong));
+        p.weakToMove = pos.getTurn() != strong;
+        if (strong == BLACK)
+            flip(p, 56);
+        normalize(id, p);
+
+        if (!getBit(tables[id], getIndex(id, p)))
+        {
+            score = 0;
+            return true;
+        }
+        Eval winScore = getWinScore(id, p);
+        score = p.weakToMove ? -winScore : winScore;
+        return true;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "position.hpp"
+#include "evaluation.hpp"
+#include "types.hpp"
+
+namespace engine
+{
+    enum BitbaseId
+    {
+        KPK,
+        KRK,
+        KQK,
+        KBNK,
+        BITBASE_COUNT
+    };
+
+    // a won position is worth this, plus the material of the strong side and
+    // a bonus that leads to the mate, so that the search makes progress
+    constexpr Eval BITBASE_WIN = 10000;
+
+    constexpr char BITBASE_MAGIC[8] = {'R', 'O', 'O', 'S', 'T', 'E', 'R', 'B'};
+    constexpr uint32_t BITBASE_VERSION = 1;
+
+    /**
+     * Win/draw bitbases of endgames where one side has only the king: one bit
+     * per position, set when the strong side wins, with either side to move.
+     * They are built by retrograde analysis from the mates, going back one
+     * move at a time. The strong side is always white in the tables, and the
+     * positions are mirrored so that its king is on the files a-d (and on
+     * the ranks 1-4 without pawns).
+     */
+    namespace bitbase
+    {
+        // build the tables in memory, the ones already available are kept
+        void generate(int threads, bool withKBNK = true);
+        bool save(const std::string &fileName);
+        // map the tables of a saved file, the ones built in memory are dropped
+        bool load(const std::string &fileName);
+        void clear();
+        bool isAvailable(BitbaseId id);
+        size_t getTableBytes(BitbaseId id);
+
+        // Return true if the position is in an available table. The score is
+        // from the side to move, 0 for a draw
+        bool probe(const Position &pos, Eval &score);
+    }
+}
+
+#endif
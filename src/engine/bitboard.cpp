@@ -5,13 +5,13 @@
 namespace engine
 {
     Bitboard betweenBB[64][64];
+    Bitboard lineBB[64][64];
     int manhattanDistance[64][64];
 
     Bitboard pawnAttacks[2][64];
     Bitboard pseudoAttacks[7][64];
 
-    Bitboard rookMagics[64][16384];
-    Bitboard bishopMagics[64][2048];
+    Bitboard magicAttacks[MAGIC_TABLE_SIZE];
 
     void initMagicTables();
 
@@ -91,6 +91,7 @@ namespace engine
                 if (tileA == tileB)
                 {
                     betweenBB[tileA][tileB] = 0;
+                    lineBB[tileA][tileB] = 0;
                 }
                 else if (fileOf(tileA) == fileOf(tileB) || rankOf(tileA) == rankOf(tileB))
                 {
@@ -98,6 +99,9 @@ namespace engine
                         getAttacksBB<ROOK>(tileA, tileBB(tileB)) &
                         getAttacksBB<ROOK>(tileB, tileBB(tileA));
                     betweenBB[tileA][tileB] |= tileBB(tileB);
+                    lineBB[tileA][tileB] =
+                        (getAttacksBB<ROOK>(tileA) & getAttacksBB<ROOK>(tileB)) |
+                        tileBB(tileA) | tileBB(tileB);
                 }
                 else if (((int)fileOf(tileA) - (int)rankOf(tileA) == (int)fileOf(tileB) - (int)rankOf(tileB)) ||
                          ((int)fileOf(tileA) + (int)rankOf(tileA) == (int)fileOf(tileB) + (int)rankOf(tileB)))
@@ -106,10 +110,14 @@ namespace engine
                         getAttacksBB<BISHOP>(tileA, tileBB(tileB)) &
                         getAttacksBB<BISHOP>(tileB, tileBB(tileA));
                     betweenBB[tileA][tileB] |= tileBB(tileB);
+                    lineBB[tileA][tileB] =
+                        (getAttacksBB<BISHOP>(tileA) & getAttacksBB<BISHOP>(tileB)) |
+                        tileBB(tileA) | tileBB(tileB);
                 }
                 else
                 {
                     betweenBB[tileA][tileB] = 0;
+                    lineBB[tileA][tileB] = 0;
                 }
             }
     }
@@ -160,7 +168,7 @@ namespace engine
         }
     }
 
-    Bitboard getSlidingAttacks(Tile tile, Bitboard blockers, SlidingDir slide)
+    Bitboard bitboard::getSlidingAttacks(Tile tile, Bitboard blockers, SlidingDir slide)
     {
         Bitboard attacks = 0;
         Direction orthDirs[4] = {UP, DOWN, RIGHT, LEFT};
@@ -184,6 +192,8 @@ namespace engine
         return attacks;
     }
 
+    // Blockers that share an entry must give the same attacks, a slider
+    // always attacks at least one tile so an empty entry is still unused
     void initMagicTables()
     {
         std::vector<Bitboard> blockers;
@@ -192,15 +202,19 @@ namespace engine
             bitboard::generateBlockers(pseudoAttacks[ROOK][tile], blockers);
             for (const auto &blocker : blockers)
             {
-                Bitboard attacks = getSlidingAttacks(tile, blocker, ORTHOGONAL);
-                rookMagics[tile][rookMagicKey(tile, blocker)] = attacks;
+                Bitboard attacks = bitboard::getSlidingAttacks(tile, blocker, ORTHOGONAL);
+                Bitboard &entry = magicAttacks[ROOK_MAGIC_OFFSETS[tile] + rookMagicKey(tile, blocker)];
+                assert(entry == 0 || entry == attacks);
+                entry = attacks;
             }
             blockers.clear();
             bitboard::generateBlockers(pseudoAttacks[BISHOP][tile], blockers);
             for (const auto &blocker : blockers)
             {
-                Bitboard attacks = getSlidingAttacks(tile, blocker, DIAGONAL);
-                bishopMagics[tile][bishopMagicKey(tile, blocker)] = attacks;
+                Bitboard attacks = bitboard::getSlidingAttacks(tile, blocker, DIAGONAL);
+                Bitboard &entry = magicAttacks[BISHOP_MAGIC_OFFSETS[tile] + bishopMagicKey(tile, blocker)];
+                assert(entry == 0 || entry == attacks);
+                entry = attacks;
             }
             blockers.clear();
         }
@@ -1,6 +1,7 @@
 #ifndef BITBOARD
 #define BITBOARD
 
+#include <array>
 #include <vector>
 #include <cassert>
 #include "types.hpp"
@@ -12,6 +13,7 @@ namespace engine
         void init();
         void print(Bitboard b);
         void generateBlockers(Bitboard movementMask, std::vector<Bitboard> &blockers);
+        Bitboard getSlidingAttacks(Tile tile, Bitboard blockers, SlidingDir slide);
     }
 
     constexpr Bitboard fileA = 0x0101010101010101ULL;
@@ -33,20 +35,35 @@ namespace engine
     constexpr Bitboard rank8 = rank1 << 56;
 
     extern Bitboard betweenBB[64][64];
+    extern Bitboard lineBB[64][64];
     extern int manhattanDistance[64][64];
 
     extern Bitboard pawnAttacks[2][64];
     extern Bitboard pseudoAttacks[7][64];
 
-    // the size depends on the worst (lowest) magic shift
-    extern Bitboard rookMagics[64][16384];
-    extern Bitboard bishopMagics[64][2048];
+    // these have been computed using a function in utils.hpp
+    constexpr Bitboard ROOK_MAGIC_NUMBERS[64] = {36031135663538180ULL, 18014467231055936ULL, 2918341904653623298ULL, 1224996690898460928ULL, 180148385288947712ULL, 16176930978206449792ULL, 4755836975561310484ULL, 2918341511395427584ULL, 39547243891559968ULL, 81205668228382724ULL, 9552416422073008144ULL, 288371182360068224ULL, 145382375897973760ULL, 10696067508093440ULL, 2594917818885537796ULL, 594756771823780096ULL, 9223513324103139376ULL, 9227875911362150464ULL, 4618521682487804160ULL, 10995418341696ULL, 1153063891429763073ULL, 4611968593050206210ULL, 13835132822341470209ULL, 90214929067426849ULL, 10817787182018740242ULL, 1460362586576552192ULL, 4521193969295360ULL, 3639190115627041801ULL, 9353980826243039360ULL, 10135300332585088ULL, 1157451853291585794ULL, 564058057097348ULL, 3026489320493023264ULL, 70506187329538ULL, 11529355921004171264ULL, 140806216222720ULL, 9511743322318701570ULL, 4612249037133842436ULL, 140746086678784ULL, 4612249519243925772ULL, 590112563575029768ULL, 5664687396700160ULL, 5764642707674792064ULL, 2954370151916535936ULL, 9297962940060729348ULL, 108650062834434060ULL, 2488520586929176660ULL, 9245045748582645762ULL, 7061785022998519936ULL, 36099307530654208ULL, 1333208160263078400ULL, 13837608937291513984ULL, 576610287025685120ULL, 4623649813039415424ULL, 1729391061870134272ULL, 145526963157664256ULL, 2325023169229881365ULL, 36310546874662945ULL, 14294188036161ULL, 90076459315560457ULL, 4900197903915814947ULL, 631066902147903510ULL, 18023263355584772ULL, 864691682573626434ULL};
+    constexpr unsigned ROOK_MAGIC_SHIFTS[64] = {52, 53, 53, 53, 53, 53, 53, 52, 53, 54, 54, 54, 54, 54, 54, 53, 53, 54, 54, 54, 54, 54, 54, 53, 53, 54, 54, 54, 54, 54, 54, 53, 53, 54, 54, 54, 54, 54, 54, 53, 53, 54, 54, 54, 54, 54, 54, 53, 53, 54, 54, 54, 54, 54, 54, 53, 52, 53, 53, 53, 53, 53, 53, 52};
+    constexpr Bitboard BISHOP_MAGIC_NUMBERS[64] = {144717754941980804ULL, 144821658673283072ULL, 905513935875112960ULL, 2306986801966907905ULL, 1130435509748238ULL, 72340206107238404ULL, 13582284607225864ULL, 4612249123071068162ULL, 1170940441355092096ULL, 72059810308431936ULL, 4613111127264733344ULL, 36305375330328ULL, 4508342350774272ULL, 2305843593866707072ULL, 5188217697839653376ULL, 2623512086905873ULL, 4774379727559394304ULL, 577604313384257796ULL, 9279667049511002122ULL, 2594233261261602818ULL, 2379027095882891936ULL, 163398427307196416ULL, 288300747110752320ULL, 567349107360000ULL, 9268980604347616288ULL, 40675350405186562ULL, 313004606542063104ULL, 865825825530847296ULL, 281749921742912ULL, 2308094946500936706ULL, 3532022774560261121ULL, 10698248546697728ULL, 9306549181744130ULL, 72216031087561249ULL, 4612812227605692455ULL, 577588853381529728ULL, 9261670243054403842ULL, 5638313377661058ULL, 5837800093319038210ULL, 14420808589920707074ULL, 325402699758044416ULL, 589481107306496ULL, 4629845569685164288ULL, 1226105136410036224ULL, 77128558981424128ULL, 5101751283875874ULL, 146516577311785984ULL, 1410699347624448ULL, 11530342050068168704ULL, 18157339584694272ULL, 6935553991779024968ULL, 36591996248392704ULL, 72084257467600904ULL, 22526868587053608ULL, 873984287036952624ULL, 293016593292722176ULL, 81698283857118208ULL, 558365688320ULL, 9223374240719056968ULL, 2306062912084771840ULL, 1154065065488450056ULL, 4787342380894276ULL, 11713897824894062724ULL, 873737914427968000ULL};
+    constexpr unsigned BISHOP_MAGIC_SHIFTS[64] = {58, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 57, 57, 57, 57, 59, 59, 59, 59, 57, 55, 55, 57, 59, 59, 59, 59, 57, 55, 55, 57, 59, 59, 59, 59, 57, 57, 57, 57, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 59, 59, 59, 59, 59, 59, 58};
 
-    // these have been computed using a function in utils.cpp
-    constexpr Bitboard ROOK_MAGIC_NUMBERS[64] = {14168668547763915772ULL, 3875625291025709983ULL, 5305752309726181668ULL, 8733511598333400245ULL, 11443603976976405858ULL, 18082796148885292900ULL, 13492861972479372005ULL, 16885870079474472360ULL, 1474293741318405145ULL, 3431890785133015648ULL, 13767795805764996565ULL, 15344422516827720041ULL, 17115561066144999560ULL, 17588146049744549041ULL, 16910400880976105729ULL, 17798601266626014022ULL, 8212195428985369068ULL, 550342953619558257ULL, 5166051718067416577ULL, 13058629318816845267ULL, 883089539731537408ULL, 10712098521701298499ULL, 5691216180035026414ULL, 15689077511333532371ULL, 45894779818419972ULL, 7993375556532614071ULL, 14669590865791011753ULL, 7162567453375249422ULL, 17102975931187384740ULL, 13964066156076506338ULL, 14772254610365216929ULL, 3776049527499379146ULL, 4401812177490590356ULL, 7257891170587440261ULL, 1598734132217305412ULL, 1841595127433507810ULL, 2252476785093064864ULL, 10198992735187805428ULL, 6006412929614733561ULL, 991383092850147378ULL, 7438296837575941801ULL, 12112295410144518381ULL, 12860194086864470549ULL, 13372877821791774295ULL, 1070076172497951345ULL, 1171627085530314133ULL, 2771912069148067222ULL, 1336538562976055311ULL, 11301854736696869440ULL, 13216613213490985587ULL, 5124508682018912436ULL, 15501490743484255658ULL, 17656472668214221940ULL, 10551659931469556781ULL, 12978827885268405646ULL, 2395658910856666256ULL, 9613276411756708054ULL, 1475703634037179350ULL, 878764786655396210ULL, 821904729637434022ULL, 11338509043517093906ULL, 9645530325025745019ULL, 13973162475916342436ULL, 5016470431788696810ULL};
-    constexpr unsigned ROOK_MAGIC_SHIFTS[64] = {50, 51, 51, 51, 51, 51, 51, 51, 51, 52, 52, 52, 52, 53, 53, 51, 51, 53, 53, 52, 52, 52, 53, 52, 51, 53, 52, 52, 52, 52, 53, 52, 52, 53, 52, 52, 52, 52, 53, 52, 51, 52, 53, 52, 52, 52, 53, 52, 52, 53, 52, 52, 53, 52, 53, 52, 51, 52, 52, 52, 51, 51, 52, 52};
-    constexpr Bitboard BISHOP_MAGIC_NUMBERS[64] = {12022524710329687762ULL, 8707736504044751749ULL, 7705672187898242757ULL, 16384271926834133526ULL, 3010735797082754920ULL, 15572606522767167279ULL, 505541677072577670ULL, 8707836444909753072ULL, 5256616179373352330ULL, 7490031656062314329ULL, 8360589813208452612ULL, 6766240849187202710ULL, 8732299444010234260ULL, 8095811696112629010ULL, 4018808582698320005ULL, 13449369775277662223ULL, 11822358432366734634ULL, 5549147248328908844ULL, 2858110899231705820ULL, 1229422534382863012ULL, 57288320873159713ULL, 13951527793579540764ULL, 16163899254536590477ULL, 16276327954655545425ULL, 17629795105785352006ULL, 3352969552377100329ULL, 17754068931298072128ULL, 17225073970085300614ULL, 11981984493624594382ULL, 11898552091916921149ULL, 17712426365282880252ULL, 18373282082841288060ULL, 12206616670598455353ULL, 11407281989990178953ULL, 13340574951256067431ULL, 11695874448775840253ULL, 4439695318095068895ULL, 2780665326407277486ULL, 18095611522545930428ULL, 13514758850565513757ULL, 17810613979390066909ULL, 9804069767419301909ULL, 11702511274606823529ULL, 17058947219799154464ULL, 11787157313989653596ULL, 15524696669592251090ULL, 1918579733512099345ULL, 12533564073731921157ULL, 17540196805672711869ULL, 16482897587364697438ULL, 15162500680135483618ULL, 9118140069798484473ULL, 12124853756487811286ULL, 14297275684270342519ULL, 14242039724707679139ULL, 15651174410979255710ULL, 187280100218578412ULL, 1378614946686541978ULL, 1535217175005450260ULL, 4680794541475891724ULL, 8999181190618459146ULL, 14865814990856129031ULL, 9270765750243035924ULL, 17344353467731415080ULL};
-    constexpr unsigned BISHOP_MAGIC_SHIFTS[64] = {57, 59, 59, 59, 59, 59, 59, 57, 59, 59, 59, 59, 59, 59, 59, 59, 59, 58, 56, 56, 56, 56, 58, 59, 58, 59, 56, 53, 53, 56, 58, 58, 59, 58, 56, 53, 53, 56, 58, 59, 59, 59, 56, 56, 56, 56, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 57, 59, 59, 59, 59, 59, 59, 57};
+    // The attacks of every square take 2^(64 - shift) entries, and the slices
+    // of all the squares are packed in one table, the rooks before the bishops
+    constexpr auto getMagicOffsets = [](const unsigned *shifts, unsigned start)
+    {
+        std::array<unsigned, 65> offsets{};
+        offsets[0] = start;
+        for (int i = 0; i < 64; i++)
+        {
+            offsets[i + 1] = offsets[i] + (1U << (64 - shifts[i]));
+        }
+        return offsets;
+    };
+    constexpr auto ROOK_MAGIC_OFFSETS = getMagicOffsets(ROOK_MAGIC_SHIFTS, 0);
+    constexpr auto BISHOP_MAGIC_OFFSETS = getMagicOffsets(BISHOP_MAGIC_SHIFTS, ROOK_MAGIC_OFFSETS[64]);
+    constexpr unsigned MAGIC_TABLE_SIZE = BISHOP_MAGIC_OFFSETS[64];
+
+    extern Bitboard magicAttacks[MAGIC_TABLE_SIZE];
 
     inline unsigned rookMagicKey(Tile from, Bitboard occupied)
     {
@@ -106,6 +123,14 @@ namespace engine
         return betweenBB[tileA][tileB];
     }
 
+    // Return the whole line (rank, file or diagonal) through two aligned tiles,
+    // or 0 if the tiles are not aligned
+    inline Bitboard getLineBB(Tile tileA, Tile tileB)
+    {
+        assert(isValid(tileA) && isValid(tileB));
+        return lineBB[tileA][tileB];
+    }
+
     template <Color C>
     inline Bitboard getPawnAttacksBB(Tile from)
     {
@@ -122,9 +147,9 @@ namespace engine
         case KNIGHT:
             return pseudoAttacks[KNIGHT][from];
         case BISHOP:
-            return bishopMagics[from][bishopMagicKey(from, occupied)];
+            return magicAttacks[BISHOP_MAGIC_OFFSETS[from] + bishopMagicKey(from, occupied)];
         case ROOK:
-            return rookMagics[from][rookMagicKey(from, occupied)];
+            return magicAttacks[ROOK_MAGIC_OFFSETS[from] + rookMagicKey(from, occupied)];
         case QUEEN:
             return getAttacksBB<BISHOP>(from, occupied) | getAttacksBB<ROOK>(from, occupied);
         case KING:
@@ -161,6 +186,18 @@ namespace engine
         return Tile(__builtin_ctzll(bitboard));
     }
 
+    // Return the most significant 1 bit of a non-zero bitboard
+    inline Tile msb(Bitboard bitboard)
+    {
+        assert(bitboard != 0);
+        return Tile(63 ^ __builtin_clzll(bitboard));
+    }
+
+    inline bool moreThanOne(Bitboard bitboard)
+    {
+        return (bitboard & (bitboard - 1)) != 0;
+    }
+
     // Return and pop the least significant 1 bit of a non-zero bitboard
     inline Tile popLsb(Bitboard &bitboard)
     {
@@ -0,0 +1,64 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include "position.hpp"
+#include "memory.hpp"
+#include "move.hpp"
+#include "types.hpp"
+
+namespace engine
+{
+    // piece-square, castling, en passant and turn keys, in this order
+    constexpr int POLYGLOT_KEY_COUNT = 781;
+    constexpr int POLYGLOT_CASTLING_OFFSET = 768;
+    constexpr int POLYGLOT_EN_PASSANT_OFFSET = 772;
+    constexpr int POLYGLOT_TURN_OFFSET = 780;
+
+    constexpr size_t POLYGLOT_ENTRY_SIZE = 16;
+
+    struct BookEntry
+    {
+        Key key;
+        uint16_t move;
+        uint16_t weight;
+        uint32_t learn;
+    };
+
+    Key getPolyglotKey(const Position &pos);
+    uint16_t toPolyglotMove(Move move);
+
+    /**
+     * Opening book in the Polyglot format: big endian entries of 16 bytes,
+     * sorted by key. The file is mapped read-only, so that the engines on
+     * the same machine share it through the page cache, and it is probed
+     * with a binary search without reading it first.
+     */
+    class Book
+    {
+    private:
+        MappedFile file;
+        size_t entryCount;
+        std::mt19937 random;
+
+        BookEntry readEntry(size_t index) const;
+        size_t lowerBound(Key key) const;
+
+    public:
+        Book();
+        ~Book();
+
+        bool open(const std::string &fileName);
+        void close();
+        bool isOpen() const;
+        size_t size() const;
+
+        // the best move takes the entry with the highest weight,
+        // otherwise the move is drawn with probability proportional to the weight
+        Move probe(const Position &pos, bool bestMove = false);
+    };
+}
+
+#endif
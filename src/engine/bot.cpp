@@ -1,6 +1,7 @@
 #include <string>
 #include <thread>
 #include "bot.hpp"
+#include "bitbase.hpp"
 #include "search.hpp"
 #include "position.hpp"
 #include "generator.hpp"
@@ -51,18 +52,19 @@ namespace engine
                     others |= tileBB(otherMove.getFrom());
                 }
             }
+            // the file is enough unless another piece is on the same file
             bool sameFile = others & fileBB(fileOf(move.getFrom()));
             bool sameRank = others & rankBB(rankOf(move.getFrom()));
-            if (!sameFile && sameRank)
+            if (others && !sameFile)
                 san += toString(fileOf(move.getFrom()));
-            else if (sameFile && !sameRank)
+            else if (others && !sameRank)
                 san += toString(rankOf(move.getFrom()));
-            else if (sameFile && sameRank)
+            else if (others)
                 san += toString(move.getFrom());
         }
 
         // capture
-        if (pos.getPiece(move.getTo()) != NULL_PIECE)
+        if (move.isCapture())
         {
             if (typeOf(piece) == PAWN)
             {
@@ -92,16 +94,19 @@ namespace engine
         return san;
     }
 
-    Bot::Bot() : pos{Position(START_FEN)}, SM{SearchManager()}, listener{NULL},
-                 thinkSemaphore{0}
+    Bot::Bot(bool ownThread, size_t hashMegabytes)
+        : pos{Position(START_FEN)}, SM{SearchManager(hashMegabytes)}, bookBestMove{false}, listener{NULL},
+          ownThread{ownThread}, thinkSemaphore{0}
     {
         SM.setListener(this);
-        thinkThread = std::thread(&Bot::runThinkThread, this);
+        if (ownThread)
+            thinkThread = std::thread(&Bot::runThinkThread, this);
     };
 
     Bot::~Bot()
     {
-        thinkThread.join();
+        if (thinkThread.joinable())
+            thinkThread.join();
     };
 
     void Bot::setListener(MoveListener *listener)
@@ -109,6 +114,50 @@ namespace engine
         this->listener = listener;
     }
 
+    void Bot::setThreads(int count)
+    {
+        SM.setThreads(count);
+    }
+
+    int Bot::getThreads() const
+    {
+        return SM.getThreads();
+    }
+
+    void Bot::setHashSize(size_t megabytes)
+    {
+        SM.setHashSize(megabytes);
+    }
+
+    // An empty name closes the book
+    bool Bot::setBookFile(const std::string &fileName)
+    {
+        if (fileName.empty())
+        {
+            book.close();
+            return true;
+        }
+        return book.open(fileName);
+    }
+
+    void Bot::setBookBestMove(bool bestMove)
+    {
+        bookBestMove = bestMove;
+    }
+
+    // The tables missing from the file are built in memory, except KBNK.
+    // An empty name keeps only those
+    bool Bot::setBitbaseFile(const std::string &fileName)
+    {
+        bool loaded = fileName.empty();
+        if (loaded)
+            bitbase::clear();
+        else
+            loaded = bitbase::load(fileName);
+        bitbase::generate(getThreads(), false);
+        return loaded;
+    }
+
     // todo maybe return a copy
     Position Bot::getPosition()
     {
@@ -187,22 +236,45 @@ namespace engine
     void Bot::startThinking(ThinkInfo info)
     {
         thinkInfo = info;
-        thinkSemaphore.release();
+        SM.resetStop(info.task == PONDER);
+        if (ownThread)
+            thinkSemaphore.release();
     }
 
     void Bot::stopThinking()
     {
-        thinkInfo.task = NOTHING;
+        SM.stop();
+    }
+
+    void Bot::ponderHit()
+    {
+        SM.ponderHit();
+    }
+
+    void Bot::onSearchInfo(const SearchInfo &info)
+    {
+        listener->onReceiveInfo(info);
     }
 
-    void Bot::onSearchInfo(Depth depth, uint64_t nodes, uint64_t timeMs, float ttOccupancy)
+    void Bot::onSearchComplete(Move move, Move ponderMove)
     {
-        listener->onReceiveInfo(depth, nodes, timeMs, ttOccupancy);
+        listener->onMoveChosen(moveToUci(move), ponderMove.isValid() ? moveToUci(ponderMove) : "");
     }
 
-    void Bot::onSearchComplete(Move move)
+    // A book move is played at once without searching, except when
+    // the GUI waits for a stop or the search is on the expected reply
+    void Bot::think()
     {
-        listener->onMoveChosen(moveToUci(move));
+        bool useBook = thinkInfo.task == SEARCH && !(thinkInfo.flags & F_INFINITE);
+        Move bookMove = useBook ? book.probe(pos, bookBestMove) : Move();
+        if (bookMove.isValid())
+        {
+            listener->onMoveChosen(moveToUci(bookMove), "");
+        }
+        else
+        {
+            SM.startSearch(pos, &thinkInfo);
+        }
     }
 
     void Bot::runThinkThread()
@@ -210,7 +282,7 @@ namespace engine
         while (true)
         {
             thinkSemaphore.acquire();
-            SM.startSearch(pos, &thinkInfo);
+            think();
         }
     }
 }
@@ -7,6 +7,7 @@
 #include <semaphore>
 #include <atomic>
 #include "search.hpp"
+#include "book.hpp"
 #include "listeners.hpp"
 #include "position.hpp"
 #include "move.hpp"
@@ -32,30 +33,42 @@ namespace engine
     private:
         Position pos;
         SearchManager SM;
+        Book book;
+        bool bookBestMove;
 
         MoveListener *listener;
 
         ThinkInfo thinkInfo;
+        bool ownThread;
         std::thread thinkThread;
         std::binary_semaphore thinkSemaphore;
 
         void runThinkThread();
 
     public:
-        Bot();
+        // without a think thread of its own, think is called by the owner
+        // after startThinking
+        Bot(bool ownThread = true, size_t hashMegabytes = DEFAULT_HASH_MB);
         ~Bot();
 
         Position getPosition();
         void setPosition(std::string fen);
         void makeTurn(std::string move);
         void setListener(MoveListener *listener);
+        void setThreads(int count);
+        int getThreads() const;
+        void setHashSize(size_t megabytes);
+        bool setBookFile(const std::string &fileName);
+        void setBookBestMove(bool bestMove);
+        bool setBitbaseFile(const std::string &fileName);
 
         void startNewGame();
         void startThinking(ThinkInfo info);
+        void think();
         void stopThinking();
-        void onSearchInfo(Depth depth, uint64_t nodes, uint64_t timeMs,
-                          float ttOccupancy) override;
-        void onSearchComplete(Move move) override;
+        void ponderHit();
+        void onSearchInfo(const SearchInfo &info) override;
+        void onSearchComplete(Move move, Move ponderMove) override;
     };
 }
 
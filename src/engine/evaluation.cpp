@@ -1,10 +1,13 @@
 #include <random>
+#include <cassert>
 #include "evaluation.hpp"
 #include "bitboard.hpp"
 
 namespace engine
 {
-    Eval evaluate(Position &pos)
+    // Sum the material and piece-square values of every piece, from the point
+    // of view of white. Position keeps the same sum updated move by move
+    Eval evaluateFromScratch(const Position &pos)
     {
         Eval eval = 0;
         for (PieceType pt : {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING})
@@ -20,7 +23,83 @@ namespace engine
                 }
             }
         }
+        return eval;
+    }
+
+    Eval evaluate(Position &pos, PawnTable &pawnTable)
+    {
+        Eval eval = pos.getPsqEval();
+        assert(eval == evaluateFromScratch(pos));
+
+        eval += pawnTable.evaluate(pos);
         // Eval distributedEval = eval + (rand() % 5) - 2;
         return eval * colorMult[pos.getTurn()];
     }
+
+    /**
+     * Static exchange evaluation: check if the sequence of captures on the
+     * target tile started by the move, where each side always recaptures with
+     * its least valuable piece and can stop when it is losing, gains at least
+     * the threshold. Sliders behind a capturing piece join the exchange once
+     * the piece in front of them is removed from the occupancy.
+     */
+    bool see(const Position &pos, Move move, Eval threshold)
+    {
+        // castling and promotions are never losing captures
+        if (move.isCastling() || move.isPromotion())
+            return 0 >= threshold;
+
+        Tile from = move.getFrom();
+        Tile to = move.getTo();
+        Eval captured = move.getFlag() == EN_PASSANT
+                            ? getPieceEval(PAWN)
+                            : getPieceEval(typeOf(pos.getPiece(to)));
+
+        // the balance after the move, and after the moving piece is captured
+        int swap = captured - threshold;
+        if (swap < 0)
+            return false;
+        swap = getPieceEval(typeOf(pos.getPiece(from))) - swap;
+        if (swap <= 0)
+            return true;
+
+        Bitboard occupied = pos.getPieces() ^ tileBB(from) ^ tileBB(to);
+        if (move.getFlag() == EN_PASSANT)
+            occupied ^= tileBB(to - getPawnPushDir(pos.getTurn()));
+
+        Bitboard bishops = pos.getPieces(BISHOP) | pos.getPieces(QUEEN);
+        Bitboard rooks = pos.getPieces(ROOK) | pos.getPieces(QUEEN);
+        Bitboard attackers = pos.getAttackersBB(to, occupied);
+        Color side = pos.getTurn();
+        int result = 1;
+
+        while (true)
+        {
+            side = ~side;
+            attackers &= occupied;
+            Bitboard sideAttackers = attackers & pos.getPieces(side);
+            if (sideAttackers == 0)
+                break;
+            result ^= 1;
+
+            PieceType pt = PAWN;
+            while ((sideAttackers & pos.getPieces(pt)) == 0)
+                pt = PieceType(pt + 1);
+
+            // the king can only capture if the other side has no attackers left
+            if (pt == KING)
+                return (attackers & pos.getPieces(~side)) != 0 ? !result : result;
+
+            swap = getPieceEval(pt) - swap;
+            if (swap < result)
+                break;
+
+            occupied ^= tileBB(lsb(sideAttackers & pos.getPieces(pt)));
+            if (pt == PAWN || pt == BISHOP || pt == QUEEN)
+                attackers |= getAttacksBB<BISHOP>(to, occupied) & bishops;
+            if (pt == ROOK || pt == QUEEN)
+                attackers |= getAttacksBB<ROOK>(to, occupied) & rooks;
+        }
+        return result;
+    }
 }
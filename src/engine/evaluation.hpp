@@ -3,6 +3,7 @@
 
 #include <limits>
 #include "position.hpp"
+#include "pawns.hpp"
 #include "move.hpp"
 #include "types.hpp"
 
@@ -11,6 +12,9 @@ namespace engine
     constexpr Eval MAX_EVAL = 20000;
     constexpr Eval MIN_EVAL = -MAX_EVAL;
 
+    // scores beyond this bound (in absolute value) are mate scores
+    constexpr Eval MATE_THRESHOLD = MAX_EVAL - 1000;
+
     constexpr Eval pieceEval[7] = {0, 100, 300, 325, 500, 900, 0};
     constexpr Eval colorMult[2] = {1, -1};
 
@@ -94,7 +98,17 @@ namespace engine
         return piecePosEval[pt][index];
     }
 
-    Eval evaluate(Position &pos);
+    // Material and position value of a piece, from the point of view of white
+    inline Eval getPieceTileEval(Piece piece, Tile tile)
+    {
+        PieceType pt = typeOf(piece);
+        Color color = colorOf(piece);
+        return (getPieceEval(pt) + getPiecePosEval(pt, color, tile)) * colorMult[color];
+    }
+
+    Eval evaluateFromScratch(const Position &pos);
+    bool see(const Position &pos, Move move, Eval threshold);
+    Eval evaluate(Position &pos, PawnTable &pawnTable);
 }
 
 #endif
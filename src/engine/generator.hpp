@@ -21,6 +21,7 @@ namespace engine
     {
         ALL,
         CAPTURES,
+        QUIETS,
     };
 
     inline void generatePromotionMoves(MoveList &moveList, Tile from, Tile to, bool isCapture)
@@ -31,8 +32,37 @@ namespace engine
         moveList.moves[moveList.size++] = Move(from, to, isCapture ? KNIGHT_PROM_CAPTURE : KNIGHT_PROM);
     }
 
+    // A pinned piece can only move along the line through its king and the pinner
+    inline bool keepsPin(Bitboard pinned, Tile kingTile, Tile from, Tile to)
+    {
+        return (pinned & tileBB(from)) == 0 || (getLineBB(kingTile, from) & tileBB(to)) != 0;
+    }
+
+    // En passant removes two pieces from the same rank, so instead of
+    // using the pin masks check directly that the king is safe after it
+    template <Color C>
+    bool isLegalEnPassant(const Position &pos, Tile kingTile, Tile from, Tile to)
+    {
+        Tile captured = to - getPawnPushDir(C);
+        Bitboard occupied = (pos.getPieces() ^ tileBB(from) ^ tileBB(captured)) | tileBB(to);
+        Bitboard enemies = pos.getPieces(~C) & ~tileBB(captured);
+        Bitboard rooks = pos.getPieces(ROOK) | pos.getPieces(QUEEN);
+        Bitboard bishops = pos.getPieces(BISHOP) | pos.getPieces(QUEEN);
+
+        return (getAttacksBB<ROOK>(kingTile, occupied) & rooks & enemies) == 0 &&
+               (getAttacksBB<BISHOP>(kingTile, occupied) & bishops & enemies) == 0 &&
+               (getAttacksBB<KNIGHT>(kingTile) & pos.getPieces(KNIGHT) & enemies) == 0 &&
+               (getPawnAttacksBB<C>(kingTile) & pos.getPieces(PAWN) & enemies) == 0;
+    }
+
+    /**
+     * Generate the legal pawn moves. The target contains the tiles that
+     * resolve the current check (all of them when not in check), while
+     * pinned pieces are only allowed to move along their pin line.
+     */
     template <GenType G, Color C>
-    void generatePseudoPawnMoves(const Position &pos, MoveList &moveList)
+    void generatePawnMoves(const Position &pos, MoveList &moveList,
+                           Tile kingTile, Bitboard target, Bitboard pinned)
     {
         constexpr Color enemyColor = ~C;
         constexpr Direction pushDir = getPawnPushDir(C);
@@ -52,54 +82,70 @@ namespace engine
         if constexpr (G != CAPTURES)
         {
             Bitboard pushes = shiftBB<pushDir>(nonPromPawns) & empty;
-            Bitboard doublePushes = shiftBB<pushDir>(pushes & doubleRank) & empty;
+            Bitboard doublePushes = shiftBB<pushDir>(pushes & doubleRank) & empty & target;
+            pushes &= target;
             while (pushes)
             {
                 Tile to = popLsb(pushes);
-                moveList.moves[moveList.size++] = Move(to - pushDir, to, QUIET);
+                if (keepsPin(pinned, kingTile, to - pushDir, to))
+                    moveList.moves[moveList.size++] = Move(to - pushDir, to, QUIET);
             }
             while (doublePushes)
             {
                 Tile to = popLsb(doublePushes);
-                moveList.moves[moveList.size++] = Move(to - pushDir - pushDir, to, DOUBLE_PUSH);
+                if (keepsPin(pinned, kingTile, to - pushDir - pushDir, to))
+                    moveList.moves[moveList.size++] = Move(to - pushDir - pushDir, to, DOUBLE_PUSH);
             }
         }
 
         // attacks (without promotions)
-        Bitboard attacksRight = shiftBB<diagRight>(nonPromPawns) & enemies;
-        Bitboard attacksLeft = shiftBB<diagLeft>(nonPromPawns) & enemies;
-        while (attacksRight)
-        {
-            Tile to = popLsb(attacksRight);
-            moveList.moves[moveList.size++] = Move(to - diagRight, to, CAPTURE);
-        }
-        while (attacksLeft)
+        if constexpr (G != QUIETS)
         {
-            Tile to = popLsb(attacksLeft);
-            moveList.moves[moveList.size++] = Move(to - diagLeft, to, CAPTURE);
+            Bitboard attacksRight = shiftBB<diagRight>(nonPromPawns) & enemies & target;
+            Bitboard attacksLeft = shiftBB<diagLeft>(nonPromPawns) & enemies & target;
+            while (attacksRight)
+            {
+                Tile to = popLsb(attacksRight);
+                if (keepsPin(pinned, kingTile, to - diagRight, to))
+                    moveList.moves[moveList.size++] = Move(to - diagRight, to, CAPTURE);
+            }
+            while (attacksLeft)
+            {
+                Tile to = popLsb(attacksLeft);
+                if (keepsPin(pinned, kingTile, to - diagLeft, to))
+                    moveList.moves[moveList.size++] = Move(to - diagLeft, to, CAPTURE);
+            }
         }
 
         // promotions
         if constexpr (G != CAPTURES)
         {
-            Bitboard promPushes = shiftBB<pushDir>(promPawns) & empty;
+            Bitboard promPushes = shiftBB<pushDir>(promPawns) & empty & target;
             while (promPushes)
             {
                 Tile to = popLsb(promPushes);
-                generatePromotionMoves(moveList, to - pushDir, to, false);
+                if (keepsPin(pinned, kingTile, to - pushDir, to))
+                    generatePromotionMoves(moveList, to - pushDir, to, false);
             }
         }
-        Bitboard promAttacksRight = shiftBB<diagRight>(promPawns) & enemies;
-        Bitboard promAttacksLeft = shiftBB<diagLeft>(promPawns) & enemies;
+        if constexpr (G == QUIETS)
+        {
+            return;
+        }
+
+        Bitboard promAttacksRight = shiftBB<diagRight>(promPawns) & enemies & target;
+        Bitboard promAttacksLeft = shiftBB<diagLeft>(promPawns) & enemies & target;
         while (promAttacksRight)
         {
             Tile to = popLsb(promAttacksRight);
-            generatePromotionMoves(moveList, to - diagRight, to, true);
+            if (keepsPin(pinned, kingTile, to - diagRight, to))
+                generatePromotionMoves(moveList, to - diagRight, to, true);
         }
         while (promAttacksLeft)
         {
             Tile to = popLsb(promAttacksLeft);
-            generatePromotionMoves(moveList, to - diagLeft, to, true);
+            if (keepsPin(pinned, kingTile, to - diagLeft, to))
+                generatePromotionMoves(moveList, to - diagLeft, to, true);
         }
 
         // en passant
@@ -109,21 +155,30 @@ namespace engine
             while (attackers)
             {
                 Tile from = popLsb(attackers);
-                moveList.moves[moveList.size++] = Move(from, pos.getEnPassant(), EN_PASSANT);
+                if (isLegalEnPassant<C>(pos, kingTile, from, pos.getEnPassant()))
+                    moveList.moves[moveList.size++] = Move(from, pos.getEnPassant(), EN_PASSANT);
             }
         }
     }
 
     template <GenType G, Color C, PieceType PT>
-    void generatePseudoMoves(const Position &pos, MoveList &moveList)
+    void generatePieceMoves(const Position &pos, MoveList &moveList,
+                            Tile kingTile, Bitboard target, Bitboard pinned)
     {
-        Bitboard pieces = pos.getPieces(PT, C);
-        Bitboard target = G == ALL ? ~pos.getPieces(C) : pos.getPieces(~C);
+        // a pinned knight can never move
+        Bitboard pieces = pos.getPieces(PT, C) & (PT == KNIGHT ? ~pinned : ~0ULL);
+        target &= G == ALL        ? ~pos.getPieces(C)
+                  : G == CAPTURES ? pos.getPieces(~C)
+                                  : pos.getEmpty();
 
         while (pieces != 0)
         {
             Tile from = popLsb(pieces);
             Bitboard attacks = getAttacksBB<PT>(from, pos.getPieces()) & target;
+            if (pinned & tileBB(from))
+            {
+                attacks &= getLineBB(kingTile, from);
+            }
             while (attacks != 0)
             {
                 Tile to = popLsb(attacks);
@@ -133,31 +188,30 @@ namespace engine
         }
     }
 
-    // Generate all legal king moves
     template <GenType G, Color C>
-    void generateKingMoves(const Position &pos, MoveList &moveList)
+    void generateKingMoves(const Position &pos, MoveList &moveList, Tile kingTile, Bitboard checkers)
     {
-        Bitboard king = pos.getPieces(KING, C);
-        Tile from = popLsb(king);
-        Bitboard target = G == ALL ? ~pos.getPieces(C) : pos.getPieces(~C);
-        Bitboard attackedTiles = pos.getAttacksBB(~C, true);
-        Bitboard attacks = getAttacksBB<KING>(from) & target & ~attackedTiles;
+        Bitboard target = G == ALL        ? ~pos.getPieces(C)
+                          : G == CAPTURES ? pos.getPieces(~C)
+                                          : pos.getEmpty();
+        Bitboard attackedTiles = pos.getKingDangerBB();
+        Bitboard attacks = getAttacksBB<KING>(kingTile) & target & ~attackedTiles;
 
         while (attacks != 0)
         {
             Tile to = popLsb(attacks);
             bool isCapture = pos.getPiece(to) != NULL_PIECE;
-            moveList.moves[moveList.size++] = Move(from, to, isCapture ? CAPTURE : QUIET);
+            moveList.moves[moveList.size++] = Move(kingTile, to, isCapture ? CAPTURE : QUIET);
         }
 
-        if constexpr (G != CAPTURES)
+        if (G != CAPTURES && checkers == 0)
         {
             CastlingRight kingSide = C == WHITE ? W_KING_SIDE : B_KING_SIDE;
             if (pos.hasCastlingRight(kingSide) &&
                 pos.castlingPathFree(kingSide) &&
                 (pos.getCastlingKingPath(kingSide) & attackedTiles) == 0)
             {
-                moveList.moves[moveList.size++] = Move(from, pos.getCastlingKingTo(kingSide), KING_CASTLE);
+                moveList.moves[moveList.size++] = Move(kingTile, pos.getCastlingKingTo(kingSide), KING_CASTLE);
             }
 
             CastlingRight queenSide = C == WHITE ? W_QUEEN_SIDE : B_QUEEN_SIDE;
@@ -165,47 +219,136 @@ namespace engine
                 pos.castlingPathFree(queenSide) &&
                 (pos.getCastlingKingPath(queenSide) & attackedTiles) == 0)
             {
-                moveList.moves[moveList.size++] = Move(from, pos.getCastlingKingTo(queenSide), QUEEN_CASTLE);
+                moveList.moves[moveList.size++] = Move(kingTile, pos.getCastlingKingTo(queenSide), QUEEN_CASTLE);
             }
         }
     }
 
-    // Generate all pseudo legal moves except for king moves
     template <GenType G, Color C>
-    void generatePseudoMoves(const Position &pos, MoveList &moveList)
+    void generateMoves(const Position &pos, MoveList &moveList)
     {
-        generatePseudoPawnMoves<G, C>(pos, moveList);
-        generatePseudoMoves<G, C, KNIGHT>(pos, moveList);
-        generatePseudoMoves<G, C, BISHOP>(pos, moveList);
-        generatePseudoMoves<G, C, ROOK>(pos, moveList);
-        generatePseudoMoves<G, C, QUEEN>(pos, moveList);
+        Tile kingTile = lsb(pos.getPieces(KING, C));
+        Bitboard checkers = pos.getCheckersBB();
+
+        // in double check only the king can move
+        if (!moreThanOne(checkers))
+        {
+            // when in check, the other pieces must capture the checker or block it
+            Bitboard target = checkers == 0
+                                  ? ~0ULL
+                                  : getBetweenBB(kingTile, lsb(checkers)) | checkers;
+            Bitboard pinned = pos.getPinnedBB();
+
+            generatePawnMoves<G, C>(pos, moveList, kingTile, target, pinned);
+            generatePieceMoves<G, C, KNIGHT>(pos, moveList, kingTile, target, pinned);
+            generatePieceMoves<G, C, BISHOP>(pos, moveList, kingTile, target, pinned);
+            generatePieceMoves<G, C, ROOK>(pos, moveList, kingTile, target, pinned);
+            generatePieceMoves<G, C, QUEEN>(pos, moveList, kingTile, target, pinned);
+        }
+
+        generateKingMoves<G, C>(pos, moveList, kingTile, checkers);
     }
 
+    /**
+     * Generate the legal moves of the side to move: all of them, only the
+     * captures, or only the moves that are not captures.
+     */
     template <GenType G>
-    void generateMoves(Position &pos, MoveList &moveList)
+    void generateMoves(const Position &pos, MoveList &moveList)
+    {
+        pos.getTurn() == WHITE ? generateMoves<G, WHITE>(pos, moveList)
+                               : generateMoves<G, BLACK>(pos, moveList);
+    }
+
+    inline CastlingRight getCastlingRight(Color color, MoveFlag flag)
+    {
+        return flag == KING_CASTLE ? (color == WHITE ? W_KING_SIDE : B_KING_SIDE)
+                                   : (color == WHITE ? W_QUEEN_SIDE : B_QUEEN_SIDE);
+    }
+
+    /**
+     * Check if a move coming from somewhere else (the TT, the killers)
+     * could have been generated in this position, ignoring checks and pins.
+     * The move flags must agree with the board as well.
+     */
+    inline bool isPseudoLegal(const Position &pos, Move move)
     {
+        if (!move.isValid())
+            return false;
+
         Color color = pos.getTurn();
-        Bitboard king = pos.getPieces(KING, color);
-        Tile kingTile = popLsb(king);
+        Tile from = move.getFrom();
+        Tile to = move.getTo();
+        MoveFlag flag = move.getFlag();
+        Piece piece = pos.getPiece(from);
+        Piece captured = pos.getPiece(to);
 
-        RevertState state;
-        MoveList pseudoMoves;
+        if (piece == NULL_PIECE || colorOf(piece) != color)
+            return false;
+        if (captured != NULL_PIECE && (colorOf(captured) == color || typeOf(captured) == KING))
+            return false;
 
-        color == WHITE ? generatePseudoMoves<G, WHITE>(pos, pseudoMoves)
-                       : generatePseudoMoves<G, BLACK>(pos, pseudoMoves);
+        if (flag == EN_PASSANT)
+            return typeOf(piece) == PAWN && to == pos.getEnPassant() &&
+                   (pawnAttacks[color][from] & tileBB(to)) != 0;
 
-        for (size_t i = 0; i < pseudoMoves.size; i++)
+        if (move.isCastling())
         {
-            pos.makeTurn(pseudoMoves.moves[i], &state);
-            if (!pos.isTileAttackedBy(kingTile, ~color))
-            {
-                moveList.moves[moveList.size++] = pseudoMoves.moves[i];
-            }
-            pos.unmakeTurn();
+            CastlingRight c = getCastlingRight(color, flag);
+            return typeOf(piece) == KING && pos.hasCastlingRight(c) &&
+                   to == pos.getCastlingKingTo(c) && pos.castlingPathFree(c);
         }
 
-        color == WHITE ? generateKingMoves<G, WHITE>(pos, moveList)
-                       : generateKingMoves<G, BLACK>(pos, moveList);
+        if (move.isCapture() != (captured != NULL_PIECE))
+            return false;
+
+        if (typeOf(piece) == PAWN)
+        {
+            Direction pushDir = getPawnPushDir(color);
+            Bitboard finalRank = color == WHITE ? rank8 : rank1;
+            if (move.isPromotion() != ((tileBB(to) & finalRank) != 0))
+                return false;
+            if (move.isCapture())
+                return (pawnAttacks[color][from] & tileBB(to)) != 0;
+            if (flag == DOUBLE_PUSH)
+                return (tileBB(from) & (color == WHITE ? rank2 : rank7)) != 0 &&
+                       to == from + pushDir + pushDir &&
+                       pos.getPiece(from + pushDir) == NULL_PIECE;
+            return to == from + pushDir;
+        }
+
+        if (flag != QUIET && flag != CAPTURE)
+            return false;
+        return (getAttacksBB(typeOf(piece), from, pos.getPieces()) & tileBB(to)) != 0;
+    }
+
+    // Check if a pseudo legal move leaves the king safe
+    inline bool isLegal(const Position &pos, Move move)
+    {
+        Color color = pos.getTurn();
+        Tile from = move.getFrom();
+        Tile to = move.getTo();
+        Tile kingTile = lsb(pos.getPieces(KING, color));
+
+        // the path includes the king tile, so this also excludes castling out of check
+        if (move.isCastling())
+            return (pos.getCastlingKingPath(getCastlingRight(color, move.getFlag())) &
+                    pos.getKingDangerBB()) == 0;
+
+        if (move.getFlag() == EN_PASSANT)
+            return color == WHITE ? isLegalEnPassant<WHITE>(pos, kingTile, from, to)
+                                  : isLegalEnPassant<BLACK>(pos, kingTile, from, to);
+
+        if (from == kingTile)
+            return (pos.getKingDangerBB() & tileBB(to)) == 0;
+
+        Bitboard checkers = pos.getCheckersBB();
+        if (checkers != 0 &&
+            (moreThanOne(checkers) ||
+             ((getBetweenBB(kingTile, lsb(checkers)) | checkers) & tileBB(to)) == 0))
+            return false;
+
+        return keepsPin(pos.getPinnedBB(), kingTile, from, to);
     }
 }
 
@@ -1,24 +1,54 @@
 #ifndef LISTENRS_H
 #define LISTENRS_H
 
+#include <cstdlib>
 #include <string>
+#include <vector>
+#include "evaluation.hpp"
+#include "transposition.hpp"
 #include "move.hpp"
 #include "types.hpp"
 
 namespace engine
 {
+    // What the search reports after an iteration or an aspiration window fail
+    struct SearchInfo
+    {
+        Depth depth;
+        int selDepth;
+        Eval score;
+        NodeType bound;
+        uint64_t nodes;
+        uint64_t qNodes;
+        uint64_t timeMs;
+        float ttOccupancy;
+        std::vector<Move> pv;
+
+        bool isMate() const
+        {
+            return std::abs(score) >= MATE_THRESHOLD;
+        }
+
+        // moves to the mate, negative when the side to move gets mated
+        int getMateMoves() const
+        {
+            return score > 0 ? (MAX_EVAL - score + 1) / 2 : -(MAX_EVAL + score) / 2;
+        }
+    };
+
     class MoveListener
     {
     public:
-        virtual void onReceiveInfo(Depth depth, uint64_t nodes, uint64_t timeMs, float ttOccupancy);
-        virtual void onMoveChosen(std::string move);
+        virtual void onReceiveInfo(const SearchInfo &info) = 0;
+        // the ponder move is empty when there's none
+        virtual void onMoveChosen(std::string move, std::string ponderMove) = 0;
     };
 
     class SearchListener
     {
     public:
-        virtual void onSearchInfo(Depth depth, uint64_t nodes, uint64_t timeMs, float ttOccupancy);
-        virtual void onSearchComplete(Move move);
+        virtual void onSearchInfo(const SearchInfo &info) = 0;
+        virtual void onSearchComplete(Move move, Move ponderMove) = 0;
     };
 }
 
@@ -0,0 +1,139 @@
+#include <cstdlib>
+#include <new>
+#include "memory.hpp"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace engine
+{
+    static size_t roundUp(size_t bytes, size_t alignment)
+    {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    void *allocLarge(size_t bytes)
+    {
+        void *mem = NULL;
+
+#if defined(_WIN32)
+        mem = _aligned_malloc(roundUp(bytes, CACHE_LINE_SIZE), CACHE_LINE_SIZE);
+#elif defined(__linux__) && defined(MADV_HUGEPAGE)
+        // transparent huge pages need 2MB alignment. If the kernel ignores
+        // the advice the block is simply backed by normal pages
+        mem = std::aligned_alloc(HUGE_PAGE_SIZE, roundUp(bytes, HUGE_PAGE_SIZE));
+        if (mem != NULL)
+        {
+            madvise(mem, roundUp(bytes, HUGE_PAGE_SIZE), MADV_HUGEPAGE);
+        }
+#else
+        mem = std::aligned_alloc(CACHE_LINE_SIZE, roundUp(bytes, CACHE_LINE_SIZE));
+#endif
+
+        if (mem == NULL)
+        {
+            throw std::bad_alloc();
+        }
+        return mem;
+    }
+
+    void freeLarge(void *mem)
+    {
+#if defined(_WIN32)
+        _aligned_free(mem);
+#else
+        std::free(mem);
+#endif
+    }
+
+    MappedFile::MappedFile() : data{NULL}, size{0}
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    bool MappedFile::open(const std::string &fileName)
+    {
+        close();
+        void *mapped = NULL;
+        size_t bytes = 0;
+
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        {
+            bytes = fileSize.QuadPart;
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL)
+            {
+                mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+        {
+            bytes = fileStat.st_size;
+            mapped = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped == MAP_FAILED)
+                mapped = NULL;
+        }
+        ::close(fd);
+#endif
+
+        if (mapped == NULL)
+            return false;
+        data = static_cast<const uint8_t *>(mapped);
+        size = bytes;
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (data == NULL)
+            return;
+
+#if defined(_WIN32)
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<uint8_t *>(data), size);
+#endif
+        data = NULL;
+        size = 0;
+    }
+
+    bool MappedFile::isOpen() const
+    {
+        return data != NULL;
+    }
+
+    const uint8_t *MappedFile::getData() const
+    {
+        return data;
+    }
+
+    size_t MappedFile::getSize() const
+    {
+        return size;
+    }
+}
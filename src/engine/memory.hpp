@@ -0,0 +1,46 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace engine
+{
+    constexpr size_t CACHE_LINE_SIZE = 64;
+    constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /**
+     * Allocate a big block of memory aligned at least to a cache line.
+     * Where the OS supports it the block is backed by huge pages, which
+     * avoids most TLB misses when probing large hash tables.
+     * Throw std::bad_alloc if the memory is not available.
+     */
+    void *allocLarge(size_t bytes);
+    void freeLarge(void *mem);
+
+    /**
+     * A file mapped read-only in memory. The pages are loaded on the first
+     * access and shared with the other processes that map the same file.
+     */
+    class MappedFile
+    {
+    private:
+        const uint8_t *data;
+        size_t size;
+
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool open(const std::string &fileName);
+        void close();
+        bool isOpen() const;
+        const uint8_t *getData() const;
+        size_t getSize() const;
+    };
+}
+
+#endif
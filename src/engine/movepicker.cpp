@@ -0,0 +1,152 @@
+#include <utility>
+#include "movepicker.hpp"
+#include "evaluation.hpp"
+
+namespace engine
+{
+    MovePicker::MovePicker(const Position &pos, Move hashMove, const Killers &killers,
+                           const int (*history)[64])
+        : pos{pos}, hashMove{hashMove}, killerA{killers.moveA}, killerB{killers.moveB},
+          history{history}, stage{HASH_MOVE}, capturesOnly{false},
+          current{0}, badCapturesEnd{0}, quietsStart{0}
+    {
+        if (!isPseudoLegal(pos, hashMove) || !isLegal(pos, hashMove))
+        {
+            this->hashMove = Move();
+            stage = GEN_CAPTURES;
+        }
+    }
+
+    MovePicker::MovePicker(const Position &pos)
+        : pos{pos}, history{NULL}, stage{GEN_CAPTURES}, capturesOnly{true},
+          current{0}, badCapturesEnd{0}, quietsStart{0}
+    {
+    }
+
+    PickStage MovePicker::getStage() const
+    {
+        return stage;
+    }
+
+    void MovePicker::scoreCaptures()
+    {
+        for (size_t i = 0; i < moveList.size; i++)
+        {
+            Move move = moveList.moves[i];
+            Piece piece = pos.getPiece(move.getFrom());
+            Piece captured = pos.getPiece(move.getTo());
+            scores[i] = MVV_LVA[typeOf(captured)][typeOf(piece)] +
+                        (move.isPromotion() ? PROM_SCORE : 0);
+        }
+    }
+
+    void MovePicker::scoreQuiets()
+    {
+        for (size_t i = quietsStart; i < moveList.size; i++)
+        {
+            Move move = moveList.moves[i];
+            scores[i] = history[move.getFrom()][move.getTo()] +
+                        (move.isPromotion() ? PROM_SCORE : 0);
+        }
+    }
+
+    // Move the best remaining move to the front of the remaining ones and return it
+    Move MovePicker::pickBest()
+    {
+        size_t best = current;
+        for (size_t i = current + 1; i < moveList.size; i++)
+        {
+            if (scores[i] > scores[best])
+                best = i;
+        }
+        std::swap(moveList.moves[current], moveList.moves[best]);
+        std::swap(scores[current], scores[best]);
+        return moveList.moves[current++];
+    }
+
+    // Killers come from sibling nodes, so they must be validated in this position
+    bool MovePicker::isValidKiller(Move move) const
+    {
+        return move != hashMove && !move.isCapture() &&
+               isPseudoLegal(pos, move) && isLegal(pos, move);
+    }
+
+    Move MovePicker::next()
+    {
+        switch (stage)
+        {
+        case HASH_MOVE:
+            stage = GEN_CAPTURES;
+            return hashMove;
+
+        case GEN_CAPTURES:
+            generateMoves<CAPTURES>(pos, moveList);
+            scoreCaptures();
+            current = 0;
+            stage = PICK_CAPTURES;
+            [[fallthrough]];
+
+        case PICK_CAPTURES:
+            while (current < moveList.size)
+            {
+                Move move = pickBest();
+                if (move == hashMove)
+                    continue;
+                if (!capturesOnly && !see(pos, move, 0))
+                {
+                    moveList.moves[badCapturesEnd++] = move;
+                    continue;
+                }
+                return move;
+            }
+            if (capturesOnly)
+            {
+                stage = DONE;
+                return Move();
+            }
+            stage = KILLER_A;
+            [[fallthrough]];
+
+        case KILLER_A:
+            stage = KILLER_B;
+            if (isValidKiller(killerA))
+                return killerA;
+            [[fallthrough]];
+
+        case KILLER_B:
+            stage = GEN_QUIETS;
+            if (killerB != killerA && isValidKiller(killerB))
+                return killerB;
+            [[fallthrough]];
+
+        case GEN_QUIETS:
+            quietsStart = moveList.size;
+            generateMoves<QUIETS>(pos, moveList);
+            scoreQuiets();
+            current = quietsStart;
+            stage = PICK_QUIETS;
+            [[fallthrough]];
+
+        case PICK_QUIETS:
+            while (current < moveList.size)
+            {
+                Move move = pickBest();
+                if (move != hashMove && move != killerA && move != killerB)
+                    return move;
+            }
+            current = 0;
+            stage = PICK_BAD_CAPTURES;
+            [[fallthrough]];
+
+        case PICK_BAD_CAPTURES:
+            if (current < badCapturesEnd)
+                return moveList.moves[current++];
+            stage = DONE;
+            [[fallthrough]];
+
+        case DONE:
+            return Move();
+        }
+        return Move();
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef MOVEPICKER_H
+#define MOVEPICKER_H
+
+#include "position.hpp"
+#include "generator.hpp"
+#include "move.hpp"
+#include "types.hpp"
+
+namespace engine
+{
+    constexpr int PROM_SCORE = 100000000;
+
+    // victim - attacker
+    constexpr int MVV_LVA[7][7] = {
+        {0, 0, 0, 0, 0, 0, 0},
+        {0, 15000000, 14000000, 13000000, 12000000, 11000000, 10000000}, // P->P, N->P, B->P, R->P, Q->P, K->P
+        {0, 25000000, 24000000, 23000000, 22000000, 21000000, 20000000}, // P->N, N->N, B->N, R->N, Q->N, K->N
+        {0, 35000000, 34000000, 33000000, 32000000, 31000000, 30000000}, // P->B, N->B, B->B, R->B, Q->B, K->B
+        {0, 45000000, 44000000, 43000000, 42000000, 41000000, 40000000}, // P->R, N->R, B->R, R->R, Q->R, K->R
+        {0, 55000000, 54000000, 53000000, 52000000, 51000000, 50000000}, // P->P, N->P, B->P, R->P, Q->P, K->P
+        {0, 0, 0, 0, 0, 0, 0},
+    };
+
+    struct Killers
+    {
+        Move moveA;
+        Move moveB;
+
+        void add(Move move)
+        {
+            if (move != moveA)
+            {
+                moveB = moveA;
+                moveA = move;
+            }
+        }
+
+        bool matchA(Move move)
+        {
+            return move == moveA;
+        }
+        bool matchB(Move move)
+        {
+            return move == moveB;
+        }
+    };
+
+    enum PickStage
+    {
+        HASH_MOVE,
+        GEN_CAPTURES,
+        PICK_CAPTURES,
+        KILLER_A,
+        KILLER_B,
+        GEN_QUIETS,
+        PICK_QUIETS,
+        PICK_BAD_CAPTURES,
+        DONE,
+    };
+
+    /**
+     * Return the legal moves of a position one at a time, in stages: the hash
+     * move, the captures that don't lose material, the killers, the quiet
+     * moves and then the losing captures. Each stage is generated and scored
+     * only when the previous one is exhausted, so a cut-off from an early
+     * move never pays for generating the later ones.
+     */
+    class MovePicker
+    {
+    private:
+        const Position &pos;
+        Move hashMove;
+        Move killerA;
+        Move killerB;
+        const int (*history)[64];
+
+        PickStage stage;
+        bool capturesOnly;
+        MoveList moveList;
+        int scores[maxMoves];
+        size_t current;
+        // captures that lose material are moved to the front of the list
+        // and tried only after the quiet moves, which are added after them
+        size_t badCapturesEnd;
+        size_t quietsStart;
+
+        void scoreCaptures();
+        void scoreQuiets();
+        Move pickBest();
+        bool isValidKiller(Move move) const;
+
+    public:
+        // Pick all the moves, for the main search
+        MovePicker(const Position &pos, Move hashMove, const Killers &killers,
+                   const int (*history)[64]);
+        // Pick only the captures, for the quiescence search
+        MovePicker(const Position &pos);
+
+        // Return the next move, or an invalid move when there are no more
+        Move next();
+        PickStage getStage() const;
+    };
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include "pawns.hpp"
+#include "bitboard.hpp"
+#include "evaluation.hpp"
+
+namespace engine
+{
+    static Rank relativeRank(Color color, Tile tile)
+    {
+        return color == WHITE ? rankOf(tile) : Rank(RANK_8 - rankOf(tile));
+    }
+
+    // Return the ranks in front of the rank, from the point of view of the color
+    static Bitboard forwardRanksBB(Color color, Rank rank)
+    {
+        if (color == WHITE)
+            return rank == RANK_8 ? 0 : ~0ULL << (8 * (rank + 1));
+        else
+            return rank == RANK_1 ? 0 : ~0ULL >> (8 * (8 - rank));
+    }
+
+    static Bitboard adjacentFilesBB(File file)
+    {
+        return (file > FILE_A ? fileBB(File(file - 1)) : 0) |
+               (file < FILE_H ? fileBB(File(file + 1)) : 0);
+    }
+
+    template <Color C>
+    static Eval evaluatePawns(const Position &pos)
+    {
+        Bitboard ownPawns = pos.getPieces(PAWN, C);
+        Bitboard enemyPawns = pos.getPieces(PAWN, ~C);
+        Eval eval = 0;
+
+        Bitboard pawns = ownPawns;
+        while (pawns != 0)
+        {
+            Tile tile = popLsb(pawns);
+            File file = fileOf(tile);
+            Bitboard forward = forwardRanksBB(C, rankOf(tile));
+            Bitboard adjacentFiles = adjacentFilesBB(file);
+
+            bool doubled = (ownPawns & forward & fileBB(file)) != 0;
+            bool passed = !doubled && (enemyPawns & forward & (fileBB(file) | adjacentFiles)) == 0;
+            bool isolated = (ownPawns & adjacentFiles) == 0;
+
+            // no pawn can support it from behind, and an enemy pawn controls the tile in front
+            Tile stop = tile + getPawnPushDir(C);
+            bool backward = !isolated && (ownPawns & adjacentFiles & ~forward) == 0 &&
+                            (pawnAttacks[C][stop] & enemyPawns) != 0;
+
+            if (doubled)
+                eval += doubledPawnEval;
+            if (passed)
+                eval += passedPawnEval[relativeRank(C, tile)];
+            if (isolated)
+                eval += isolatedPawnEval;
+            if (backward)
+                eval += backwardPawnEval;
+        }
+        return eval;
+    }
+
+    // Evaluate the passed, doubled, isolated and backward pawns of both sides
+    Eval evaluatePawns(const Position &pos)
+    {
+        return evaluatePawns<WHITE>(pos) - evaluatePawns<BLACK>(pos);
+    }
+
+    // Evaluate the pawns in front of the king on its file and the adjacent ones
+    Eval evaluateShelter(const Position &pos, Color color)
+    {
+        Tile kingTile = lsb(pos.getPieces(KING, color));
+        File kingFile = fileOf(kingTile);
+        Bitboard pawns = pos.getPieces(PAWN, color) & forwardRanksBB(color, rankOf(kingTile));
+        Eval eval = 0;
+
+        for (int file = std::max<int>(kingFile - 1, FILE_A); file <= std::min<int>(kingFile + 1, FILE_H); file++)
+        {
+            Bitboard filePawns = pawns & fileBB(File(file));
+            int distance = 0;
+            if (filePawns != 0)
+            {
+                Tile closest = color == WHITE ? lsb(filePawns) : msb(filePawns);
+                distance = std::min(relativeRank(color, closest) - relativeRank(color, kingTile), 3);
+            }
+            eval += shelterEval[distance];
+        }
+        return eval;
+    }
+
+    PawnTable::PawnTable()
+    {
+        clear();
+    }
+
+    void PawnTable::clear()
+    {
+        for (PawnEntry &entry : entries)
+        {
+            // a zero key is also the key without pawns, whose score is zero
+            entry = {0, 0, {NULL_TILE, NULL_TILE}, {0, 0}};
+        }
+        resetStats();
+    }
+
+    void PawnTable::resetStats()
+    {
+        accesses = 0;
+        hits = 0;
+    }
+
+    PawnEntry &PawnTable::probe(const Position &pos)
+    {
+        Key key = pos.getPawnKey();
+        PawnEntry &entry = entries[key & (PAWN_TABLE_SIZE - 1)];
+        accesses++;
+        if (entry.key == key)
+        {
+            hits++;
+            return entry;
+        }
+
+        entry.key = key;
+        entry.eval = evaluatePawns(pos);
+        entry.kingTile[WHITE] = entry.kingTile[BLACK] = NULL_TILE;
+        return entry;
+    }
+
+    // Return the pawn structure and king shelter score, from the point of view of white
+    Eval PawnTable::evaluate(const Position &pos)
+    {
+        PawnEntry &entry = probe(pos);
+        Eval eval = entry.eval;
+
+        // the shelter only matters while the enemy queen can attack the king
+        Bitboard queens = pos.getPieces(QUEEN);
+        Bitboard kings = pos.getPieces(KING);
+        for (Color color : {WHITE, BLACK})
+        {
+            if ((queens & pos.getPieces(~color)) == 0)
+                continue;
+
+            Tile kingTile = lsb(kings & pos.getPieces(color));
+            if (entry.kingTile[color] != kingTile)
+            {
+                entry.kingTile[color] = kingTile;
+                entry.shelter[color] = evaluateShelter(pos, color);
+            }
+            eval += entry.shelter[color] * colorMult[color];
+        }
+        return eval;
+    }
+
+    uint64_t PawnTable::getAccesses() const
+    {
+        return accesses;
+    }
+
+    uint64_t PawnTable::getHits() const
+    {
+        return hits;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include "position.hpp"
+#include "types.hpp"
+
+namespace engine
+{
+    constexpr size_t PAWN_TABLE_SIZE = 1 << 12;
+
+    // indexed by the rank of the pawn, seen from its own side
+    constexpr Eval passedPawnEval[8] = {0, 5, 10, 20, 35, 60, 100, 0};
+    constexpr Eval doubledPawnEval = -10;
+    constexpr Eval isolatedPawnEval = -15;
+    constexpr Eval backwardPawnEval = -8;
+
+    // indexed by how many ranks in front of the king the closest pawn of
+    // a file is, where 0 means that there is no pawn in front of the king
+    constexpr Eval shelterEval[4] = {-20, 10, 5, -10};
+
+    struct PawnEntry
+    {
+        Key key;
+        // pawn structure score from the point of view of white
+        Eval eval;
+        // the shelter only depends on the pawns and the king, so it is kept
+        // until the king moves to a different tile
+        uint8_t kingTile[2];
+        Eval shelter[2];
+    };
+
+    static_assert(sizeof(PawnEntry) == 16, "four entries must fit in a cache line");
+
+    /**
+     * Cache of the pawn structure evaluation, indexed by the pawn key. The
+     * pawns change much less often than the other pieces, so most probes
+     * find the entry already computed. Every search thread has its own.
+     */
+    class PawnTable
+    {
+    private:
+        PawnEntry entries[PAWN_TABLE_SIZE];
+        uint64_t accesses;
+        uint64_t hits;
+
+        PawnEntry &probe(const Position &pos);
+
+    public:
+        PawnTable();
+
+        void clear();
+        void resetStats();
+        Eval evaluate(const Position &pos);
+        uint64_t getAccesses() const;
+        uint64_t getHits() const;
+    };
+
+    Eval evaluatePawns(const Position &pos);
+    Eval evaluateShelter(const Position &pos, Color color);
+}
+
+#endif
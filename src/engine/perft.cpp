@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "perft.hpp"
+#include "generator.hpp"
+#include "memory.hpp"
+#include "misc.hpp"
+
+namespace engine
+{
+    PerftHash::PerftHash(size_t megabytes)
+    {
+        slotCount = std::max<size_t>(megabytes * 1024 * 1024 / sizeof(PerftSlot), 1);
+        slots = static_cast<PerftSlot *>(allocLarge(slotCount * sizeof(PerftSlot)));
+        std::memset(static_cast<void *>(slots), 0, slotCount * sizeof(PerftSlot));
+    }
+
+    PerftHash::~PerftHash()
+    {
+        freeLarge(slots);
+    }
+
+    // the same position has a different count at every depth
+    Key PerftHash::getKey(Key key, Depth depth)
+    {
+        return key ^ (0x9e3779b97f4a7c15ULL * (uint64_t)(depth + 1));
+    }
+
+    PerftHash::PerftSlot &PerftHash::getSlot(Key key) const
+    {
+        return slots[(size_t)(((__uint128_t)key * slotCount) >> 64)];
+    }
+
+    bool PerftHash::get(Key key, Depth depth, uint64_t &nodes) const
+    {
+        key = getKey(key, depth);
+        PerftSlot &slot = getSlot(key);
+        uint64_t keyXorNodes = slot.keyXorNodes.load(std::memory_order_relaxed);
+        nodes = slot.nodes.load(std::memory_order_relaxed);
+        return (keyXorNodes ^ nodes) == key;
+    }
+
+    void PerftHash::add(Key key, Depth depth, uint64_t nodes)
+    {
+        key = getKey(key, depth);
+        PerftSlot &slot = getSlot(key);
+        slot.keyXorNodes.store(key ^ nodes, std::memory_order_relaxed);
+        slot.nodes.store(nodes, std::memory_order_relaxed);
+    }
+
+    // The leaves are never made, at depth 1 the count is the number of legal moves
+    uint64_t perft(Position &pos, Depth depth, PerftHash *hash)
+    {
+        if (depth <= 0)
+        {
+            return 1;
+        }
+
+        uint64_t count;
+        if (hash != NULL && depth > 1 && hash->get(pos.getZobristKey(), depth, count))
+        {
+            return count;
+        }
+
+        MoveList moveList = MoveList();
+        generateMoves<ALL>(pos, moveList);
+
+        if (depth == 1)
+            return moveList.size;
+
+        RevertState state;
+        count = 0;
+        for (size_t i = 0; i < moveList.size; i++)
+        {
+            pos.makeTurn(moveList.moves[i], &state);
+            count += perft(pos, depth - 1, hash);
+            pos.unmakeTurn();
+        }
+
+        if (hash != NULL)
+        {
+            hash->add(pos.getZobristKey(), depth, count);
+        }
+        return count;
+    }
+
+    // Below depth 3 the work is split by root move. Deeper, it is split by
+    // the moves two plies from the root, since a few root moves usually hold
+    // most of the nodes and would leave the other threads idle at the end
+    PerftResult parallelPerft(const Position &pos, Depth depth, int threads, size_t hashMegabytes)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        PerftResult result{depth <= 0 ? 1ULL : 0ULL, 0, {}, {}};
+        if (depth <= 0)
+        {
+            return result;
+        }
+
+        threads = std::max(threads, 1);
+        PerftHash *hash = hashMegabytes > 0 ? new PerftHash(hashMegabytes) : NULL;
+        Position rootPos = pos;
+
+        MoveList rootMoves = MoveList();
+        generateMoves<ALL>(rootPos, rootMoves);
+
+        // every task is the index of a root move and a reply, or no reply
+        std::vector<std::pair<size_t, Move>> tasks;
+        for (size_t i = 0; i < rootMoves.size; i++)
+        {
+            if (depth < 3)
+            {
+                tasks.emplace_back(i, Move());
+                continue;
+            }
+
+            RevertState state;
+            MoveList replies = MoveList();
+            rootPos.makeTurn(rootMoves.moves[i], &state);
+            generateMoves<ALL>(rootPos, replies);
+            rootPos.unmakeTurn();
+
+            for (size_t j = 0; j < replies.size; j++)
+            {
+                tasks.emplace_back(i, replies.moves[j]);
+            }
+        }
+
+        std::atomic<size_t> nextTask{0};
+        std::vector<std::vector<uint64_t>> rootCounts(threads, std::vector<uint64_t>(rootMoves.size, 0));
+        result.threads.resize(threads);
+
+        auto work = [&](int id)
+        {
+            auto threadBegin = std::chrono::steady_clock::now();
+            Position local = rootPos;
+            RevertState rootState, replyState;
+            uint64_t nodes = 0;
+
+            size_t task;
+            while ((task = nextTask.fetch_add(1, std::memory_order_relaxed)) < tasks.size())
+            {
+                auto [root, reply] = tasks[task];
+                uint64_t count;
+
+                local.makeTurn(rootMoves.moves[root], &rootState);
+                if (reply.isValid())
+                {
+                    local.makeTurn(reply, &replyState);
+                    count = perft(local, depth - 2, hash);
+                    local.unmakeTurn();
+                }
+                else
+                {
+                    count = perft(local, depth - 1, hash);
+                }
+                local.unmakeTurn();
+
+                rootCounts[id][root] += count;
+                nodes += count;
+            }
+
+            result.threads[id] = {nodes, getTimeMs(threadBegin, std::chrono::steady_clock::now())};
+        };
+
+        std::vector<std::thread> helpers;
+        for (int i = 1; i < threads; i++)
+        {
+            helpers.emplace_back(work, i);
+        }
+        work(0);
+        for (auto &helper : helpers)
+        {
+            helper.join();
+        }
+        delete hash;
+
+        for (size_t i = 0; i < rootMoves.size; i++)
+        {
+            uint64_t count = 0;
+            for (int id = 0; id < threads; id++)
+            {
+                count += rootCounts[id][i];
+            }
+            result.divide.emplace_back(rootMoves.moves[i], count);
+            result.nodes += count;
+        }
+        result.timeMs = getTimeMs(begin, std::chrono::steady_clock::now());
+        return result;
+    }
+}
@@ -1,42 +1,63 @@
 #ifndef PERFT
 #define PERFT
 
-#include <iostream>
+#include <atomic>
 #include <cstdint>
+#include <utility>
+#include <vector>
 #include "position.hpp"
-#include "generator.hpp"
+#include "move.hpp"
 #include "types.hpp"
 
 namespace engine
 {
-    uint64_t perft(Position &pos, Depth depth, bool root = true)
+    /**
+     * Node counts of subtrees, keyed by zobrist key and depth. Like the
+     * transposition table, a count is stored next to the key xored with it,
+     * so that threads share the table without locks and a torn entry is
+     * never returned. Entries are always replaced.
+     */
+    class PerftHash
     {
-        if (depth <= 0)
+    private:
+        struct PerftSlot
         {
-            return 1;
-        }
+            std::atomic<uint64_t> keyXorNodes;
+            std::atomic<uint64_t> nodes;
+        };
 
-        RevertState state;
-        MoveList moveList = MoveList();
-        generateMoves<ALL>(pos, moveList);
+        PerftSlot *slots;
+        size_t slotCount;
 
-        if (depth == 1 && !root)
-            return moveList.size;
+        static Key getKey(Key key, Depth depth);
+        PerftSlot &getSlot(Key key) const;
 
-        uint64_t count = 0;
-        for (size_t i = 0; i < moveList.size; i++)
-        {
-            pos.makeTurn(moveList.moves[i], &state);
-            uint64_t newCount = perft(pos, depth - 1, false);
-            pos.unmakeTurn();
+    public:
+        PerftHash(size_t megabytes);
+        ~PerftHash();
+
+        bool get(Key key, Depth depth, uint64_t &nodes) const;
+        void add(Key key, Depth depth, uint64_t nodes);
+    };
 
-            count += newCount;
-            if (root)
-                std::cout << moveList.moves[i] << ": " << newCount << std::endl;
-        }
+    struct PerftThreadInfo
+    {
+        // leaf nodes counted by the thread, including the ones found in the hash
+        uint64_t nodes;
+        int64_t timeMs;
+    };
 
-        return count;
-    }
+    struct PerftResult
+    {
+        uint64_t nodes;
+        int64_t timeMs;
+        // leaf nodes under every root move, in generation order
+        std::vector<std::pair<Move, uint64_t>> divide;
+        std::vector<PerftThreadInfo> threads;
+    };
+
+    uint64_t perft(Position &pos, Depth depth, PerftHash *hash = NULL);
+    PerftResult parallelPerft(const Position &pos, Depth depth, int threads = 1, size_t hashMegabytes = 0);
 }
 
 #endif
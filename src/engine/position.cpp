@@ -2,13 +2,14 @@
 #include <algorithm>
 #include "position.hpp"
 #include "bitboard.hpp"
+#include "evaluation.hpp"
 
 namespace engine
 {
     Position::Position(const std::string &fen)
         : typeBB{0, 0, 0, 0, 0, 0, 0}, colorBB{0, 0},
           castling(NULL_CASTLING), enPassant(NULL_TILE),
-          zobristKey(0ULL), state{NULL}
+          psqEval{0}, zobristKey(0ULL), pawnKey(0ULL), historySize{0}, pliesFromNull{0}, state{NULL}
     {
         for (Tile tile = A1; tile <= H8; ++tile)
             board[tile] = NULL_PIECE;
@@ -36,6 +37,7 @@ namespace engine
             {
                 Piece piece = CHAR_TO_PIECE.at(c);
                 board[tile] = piece;
+                psqEval += getPieceTileEval(piece, (Tile)tile);
                 setBit(typeBB[typeOf(piece)], (Tile)tile);
                 setBit(colorBB[colorOf(piece)], (Tile)tile);
                 tile++;
@@ -101,6 +103,8 @@ namespace engine
         }
 
         initZobristKey();
+        updateCheckInfo();
+        pushKey(true);
     }
 
     std::string Position::getFen() const
@@ -287,6 +291,70 @@ namespace engine
                    : getAttacksBB<BLACK>(excludeKingBlocker);
     }
 
+    // Return the pieces of both colors attacking the tile
+    Bitboard Position::getAttackersBB(Tile tile, Bitboard occupied) const
+    {
+        return (getPawnAttacksBB<BLACK>(tile) & getPieces(PAWN, WHITE)) |
+               (getPawnAttacksBB<WHITE>(tile) & getPieces(PAWN, BLACK)) |
+               (engine::getAttacksBB<KNIGHT>(tile) & typeBB[KNIGHT]) |
+               (engine::getAttacksBB<BISHOP>(tile, occupied) & (typeBB[BISHOP] | typeBB[QUEEN])) |
+               (engine::getAttacksBB<ROOK>(tile, occupied) & (typeBB[ROOK] | typeBB[QUEEN])) |
+               (engine::getAttacksBB<KING>(tile) & typeBB[KING]);
+    }
+
+    /**
+     * Compute the checkers and the pinned pieces of the side to move. They
+     * are needed by every move generation and check test, so they are
+     * computed once per move instead of on every call.
+     */
+    void Position::updateCheckInfo()
+    {
+        Tile kingTile = lsb(getPieces(KING, turn));
+        checkers = getAttackersBB(kingTile, getPieces()) & getPieces(~turn);
+        kingDanger = 0;
+        kingDangerReady = false;
+
+        Bitboard snipers =
+            ((engine::getAttacksBB<ROOK>(kingTile) & (typeBB[ROOK] | typeBB[QUEEN])) |
+             (engine::getAttacksBB<BISHOP>(kingTile) & (typeBB[BISHOP] | typeBB[QUEEN]))) &
+            getPieces(~turn);
+
+        pinned = 0;
+        while (snipers != 0)
+        {
+            Tile sniper = popLsb(snipers);
+            Bitboard blockers = getBetweenBB(kingTile, sniper) & ~tileBB(sniper) & getPieces();
+            if (blockers != 0 && !moreThanOne(blockers))
+            {
+                pinned |= blockers & getPieces(turn);
+            }
+        }
+    }
+
+    // Return the enemy pieces giving check to the side to move
+    Bitboard Position::getCheckersBB() const
+    {
+        return checkers;
+    }
+
+    // Return the pieces of the side to move that are pinned to their king
+    Bitboard Position::getPinnedBB() const
+    {
+        return pinned;
+    }
+
+    // Return the tiles attacked by the enemy, seen through the king of the side
+    // to move so that it can't step back along the line of a slider
+    Bitboard Position::getKingDangerBB() const
+    {
+        if (!kingDangerReady)
+        {
+            kingDanger = getAttacksBB(~turn, true);
+            kingDangerReady = true;
+        }
+        return kingDanger;
+    }
+
     bool Position::isTileAttackedBy(Tile tile, Color color) const
     {
         Bitboard allPieces = getPieces();
@@ -312,7 +380,7 @@ namespace engine
 
     bool Position::isKingInCheck() const
     {
-        return isKingInCheck(turn);
+        return checkers != 0;
     }
 
     void Position::makeTurn(Move move, RevertState *newState)
@@ -327,7 +395,12 @@ namespace engine
             newState->castling = castling;
             newState->enPassant = enPassant;
             newState->halfMove = halfMove;
+            newState->pliesFromNull = pliesFromNull;
             newState->captured = board[to];
+            newState->checkers = checkers;
+            newState->pinned = pinned;
+            newState->kingDanger = kingDanger;
+            newState->kingDangerReady = kingDangerReady;
             newState->zobristKey = zobristKey;
             newState->previous = state;
             state = newState;
@@ -336,9 +409,10 @@ namespace engine
         halfMove += 1;
         if (board[to] != NULL_PIECE || typeOf(board[from]) == PAWN)
         {
+            // a game move that can't be undone makes all the previous positions unreachable
             if (newState == NULL)
             {
-                repetitions.clear();
+                historySize = 0;
             }
             halfMove = 0;
         }
@@ -448,7 +522,9 @@ namespace engine
         }
 
         switchTurn();
-        repetitions.push_back(zobristKey);
+        updateCheckInfo();
+        pliesFromNull++;
+        pushKey(newState == NULL);
     }
 
     void Position::unmakeTurn()
@@ -459,7 +535,7 @@ namespace engine
         }
         assert(state->move.raw() != 0);
 
-        repetitions.pop_back();
+        historySize--;
         switchTurn();
 
         Tile from = state->move.getFrom();
@@ -506,18 +582,27 @@ namespace engine
         castling = state->castling;
         enPassant = state->enPassant;
         halfMove = state->halfMove;
+        pliesFromNull = state->pliesFromNull;
+        checkers = state->checkers;
+        pinned = state->pinned;
+        kingDanger = state->kingDanger;
+        kingDangerReady = state->kingDangerReady;
         zobristKey = state->zobristKey;
         state = state->previous;
     }
 
-    // todo how to handle repetitions
     void Position::makeNullMove(RevertState *newState)
     {
         newState->move = Move();
         newState->castling = castling;
         newState->enPassant = enPassant;
         newState->halfMove = halfMove;
+        newState->pliesFromNull = pliesFromNull;
         newState->captured = NULL_PIECE;
+        newState->checkers = checkers;
+        newState->pinned = pinned;
+        newState->kingDanger = kingDanger;
+        newState->kingDangerReady = kingDangerReady;
         newState->zobristKey = zobristKey;
         newState->previous = state;
         state = newState;
@@ -535,6 +620,9 @@ namespace engine
         }
 
         switchTurn();
+        updateCheckInfo();
+        pliesFromNull = 0;
+        pushKey(false);
     }
 
     void Position::unmakeNullMove()
@@ -545,6 +633,7 @@ namespace engine
         }
         assert(state->move.raw() == 0);
 
+        historySize--;
         switchTurn();
         if (turn == BLACK)
         {
@@ -554,14 +643,45 @@ namespace engine
         castling = state->castling;
         enPassant = state->enPassant;
         halfMove = state->halfMove;
+        pliesFromNull = state->pliesFromNull;
+        checkers = state->checkers;
+        pinned = state->pinned;
+        kingDanger = state->kingDanger;
+        kingDangerReady = state->kingDangerReady;
         zobristKey = state->zobristKey;
         state = state->previous;
     }
 
+    void Position::pushKey(bool gameMove)
+    {
+        // game moves are never undone, so when a very long game fills the
+        // history the oldest half can be dropped. Search never fills it
+        if (gameMove && historySize == MAX_PLIES)
+        {
+            std::copy(keyHistory + MAX_PLIES / 2, keyHistory + MAX_PLIES, keyHistory);
+            historySize -= MAX_PLIES / 2;
+        }
+        assert(historySize < MAX_PLIES);
+        keyHistory[historySize++] = zobristKey;
+    }
+
+    /**
+     * Check if the current position occurred twice before. Only the positions
+     * since the last capture, pawn move or null move can be the same, and
+     * only every other one has the same side to move.
+     */
     bool Position::isRepeated() const
     {
-        return repetitions.size() >= 3 &&
-               std::count(repetitions.begin(), repetitions.end(), repetitions.back()) >= 3;
+        int window = std::min({halfMove, pliesFromNull, historySize - 1});
+        int count = 1;
+        for (int i = 4; i <= window; i += 2)
+        {
+            if (keyHistory[historySize - 1 - i] == zobristKey && ++count >= 3)
+            {
+                return true;
+            }
+        }
+        return false;
     }
 
     void Position::print() const
@@ -592,16 +712,28 @@ namespace engine
                   << std::endl;
     }
 
+    Eval Position::getPsqEval() const
+    {
+        return psqEval;
+    }
+
     Key Position::getZobristKey() const
     {
         return zobristKey;
     }
 
+    Key Position::getPawnKey() const
+    {
+        return pawnKey;
+    }
+
     void Position::initZobristKey()
     {
         for (Tile tile = A1; tile <= H8; ++tile)
         {
             zobristKey ^= getPieceTileZ(getPiece(tile), tile);
+            if (typeOf(getPiece(tile)) == PAWN)
+                pawnKey ^= getPieceTileZ(getPiece(tile), tile);
         }
         if (turn == BLACK)
         {
@@ -623,6 +755,9 @@ namespace engine
         zobristKey ^= getPieceTileZ(board[tile], tile);
         zobristKey ^= getPieceTileZ(piece, tile);
         board[tile] = piece;
+        psqEval += getPieceTileEval(piece, tile);
+        if (typeOf(piece) == PAWN)
+            pawnKey ^= getPieceTileZ(piece, tile);
         setBit(typeBB[typeOf(piece)], tile);
         setBit(colorBB[colorOf(piece)], tile);
     }
@@ -633,6 +768,9 @@ namespace engine
         zobristKey ^= getPieceTileZ(piece, tile);
         zobristKey ^= getPieceTileZ(NULL_PIECE, tile);
         board[tile] = NULL_PIECE;
+        psqEval -= getPieceTileEval(piece, tile);
+        if (typeOf(piece) == PAWN)
+            pawnKey ^= getPieceTileZ(piece, tile);
         clearBit(typeBB[typeOf(piece)], tile);
         clearBit(colorBB[colorOf(piece)], tile);
     }
@@ -3,7 +3,6 @@
 
 #include <string>
 #include <map>
-#include <vector>
 #include "move.hpp"
 #include "zobrist.hpp"
 #include "types.hpp"
@@ -16,6 +15,10 @@ namespace engine
     static const char FEN_RANKS_DELIMITER = '/';
     static const char FEN_EMPTY = '-';
 
+    // keys kept for repetition detection, enough for the reversible
+    // moves of a game plus the deepest search line
+    constexpr int MAX_PLIES = 1024;
+
     static const std::map<char, Piece> CHAR_TO_PIECE = {
         {'P', W_PAWN},
         {'N', W_KNIGHT},
@@ -76,7 +79,12 @@ namespace engine
         CastlingRight castling;
         Tile enPassant;
         int halfMove;
+        int pliesFromNull;
         Piece captured;
+        Bitboard checkers;
+        Bitboard pinned;
+        Bitboard kingDanger;
+        bool kingDangerReady;
 
         Key zobristKey;
         RevertState *previous;
@@ -94,11 +102,30 @@ namespace engine
         int halfMove;
         int fullMove;
 
+        // check information for the side to move, updated after every move.
+        // The king danger tiles are only needed to move the king, so many
+        // nodes never ask for them and they are computed on the first use
+        Bitboard checkers;
+        Bitboard pinned;
+        mutable Bitboard kingDanger;
+        mutable bool kingDangerReady;
+
+        // material and piece-square score from the point of view of white
+        Eval psqEval;
+
         Key zobristKey;
-        std::vector<Key> repetitions;
+        // the key of the pawns only, for the pawn structure evaluation
+        Key pawnKey;
+        // the keys of the positions since the last irreversible game move,
+        // the current one included, indexed by ply
+        Key keyHistory[MAX_PLIES];
+        int historySize;
+        int pliesFromNull;
         RevertState *state;
 
         void initZobristKey();
+        void updateCheckInfo();
+        void pushKey(bool gameMove);
 
         void setPiece(Tile tile, Piece piece);
         void clearPiece(Tile tile);
@@ -132,6 +159,10 @@ namespace engine
         template <Color C>
         Bitboard getAttacksBB(bool excludeKingBlocker = false) const;
         Bitboard getAttacksBB(Color color, bool excludeKingBlocker = false) const;
+        Bitboard getAttackersBB(Tile tile, Bitboard occupied) const;
+        Bitboard getCheckersBB() const;
+        Bitboard getPinnedBB() const;
+        Bitboard getKingDangerBB() const;
         bool isTileAttackedBy(Tile tile, Color color) const;
         bool isKingInCheck(Color color) const;
         bool isKingInCheck() const;
@@ -141,7 +172,9 @@ namespace engine
         void makeNullMove(RevertState *newState);
         void unmakeNullMove();
 
+        Eval getPsqEval() const;
         Key getZobristKey() const;
+        Key getPawnKey() const;
         bool isRepeated() const;
         void print() const;
     };
@@ -2,153 +2,509 @@
 #include <array>
 #include <limits>
 #include <chrono>
-#include <cassert>
+#include <cmath>
+#include <thread>
 #include "search.hpp"
+#include "bitbase.hpp"
 #include "evaluation.hpp"
 #include "generator.hpp"
+#include "movepicker.hpp"
 #include "move.hpp"
 #include "types.hpp"
 #include "misc.hpp"
 
 namespace engine
 {
-    SearchManager::SearchManager() : TT{TranspositionTable()}, listener{NULL},
-                                     thinkInfo{NULL} {}
+    // late move reductions by remaining depth and number of moves searched,
+    // growing with the logarithm of both
+    const auto reductions = []
+    {
+        std::array<std::array<Depth, 64>, MAX_DEPTH + 1> table{};
+        for (int depth = 1; depth <= MAX_DEPTH; depth++)
+        {
+            for (int moves = 1; moves < 64; moves++)
+            {
+                table[depth][moves] = Depth(LMR_BASE + std::log(depth) * std::log(moves) / LMR_DIVISOR);
+            }
+        }
+        return table;
+    }();
 
-    void SearchManager::setListener(SearchListener *listener)
+    SearchWorker::SearchWorker(SearchManager *manager, int id)
+        : manager{manager}, id{id}, nodes{0}
     {
-        this->listener = listener;
+        clear();
     }
 
-    void SearchManager::clear()
+    void SearchWorker::clear()
     {
-        TT.clear();
         for (size_t i = 0; i < std::size(killers); i++)
         {
-            killers[i].add(Move());
-            killers[i].add(Move());
+            killers[i] = Killers();
         }
         for (Color color : {WHITE, BLACK})
             for (Tile from = A1; from <= H8; ++from)
                 for (Tile to = A1; to <= H8; ++to)
                     history[color][from][to] = 0;
+        pawnTable.clear();
+
+        resetStats();
+    }
+
+    // Prepare for the search of the next move of the same game, keeping
+    // the move ordering information learned by the previous searches
+    void SearchWorker::newSearch()
+    {
+        // two plies have been played since the previous search,
+        // so its killers at ply i + 2 are the killers at ply i now
+        for (size_t i = 0; i < std::size(killers); i++)
+        {
+            killers[i] = i + 2 < std::size(killers) ? killers[i + 2] : Killers();
+        }
+        for (Color color : {WHITE, BLACK})
+            for (Tile from = A1; from <= H8; ++from)
+                for (Tile to = A1; to <= H8; ++to)
+                    history[color][from][to] /= HISTORY_DECAY;
+
+        resetStats();
+    }
 
+    void SearchWorker::resetStats()
+    {
         moveToMake = Move();
+        rootPvLength = 0;
+        rootDepth = 0;
+        selDepth = 0;
+        checksToClockPoll = CLOCK_POLL_INTERVAL;
         nodes = 0;
         qNodes = 0;
         cutOffs = 0;
+        failLows = 0;
+        failHighs = 0;
+        moveCutOffs = 0;
+        firstMoveCutOffs = 0;
+        quietGenerations = 0;
         ttAccesses = 0;
         ttHits = 0;
+        pawnTable.resetStats();
     }
 
-    void SearchManager::startSearch(Position &pos, ThinkInfo *info)
+    uint64_t SearchWorker::getNodes() const
     {
-        uint64_t thinkTime = calcThinkTimeMs(*info, pos.getTurn());
-        thinkInfo = info;
-        startTime = std::chrono::steady_clock::now();
-        endTime = startTime + std::chrono::milliseconds(thinkTime);
-        Move bestMove = runIterativeDeepening(pos);
-        thinkInfo = NULL;
-        listener->onSearchComplete(bestMove);
+        return nodes.load(std::memory_order_relaxed);
     }
 
-    Move SearchManager::runIterativeDeepening(Position &pos, Depth maxDepth, SearchDiagnostic *sc)
+    uint64_t SearchWorker::getQNodes() const
     {
-        // todo maybe don't clear in the future
-        clear();
+        return qNodes.load(std::memory_order_relaxed);
+    }
+
+    // Stop checks happen at every node, so they only read a flag. The clock
+    // is read by the main thread alone, once every CLOCK_POLL_INTERVAL checks
+    bool SearchWorker::shouldStop()
+    {
+        if (id == 0 && --checksToClockPoll <= 0)
+        {
+            checksToClockPoll = CLOCK_POLL_INTERVAL;
+            manager->pollClock();
+        }
+        return manager->stopped.load(std::memory_order_relaxed);
+    }
+
+    // Only the owning thread writes the counters, other threads just read them
+    void SearchWorker::countNode()
+    {
+        uint64_t count = nodes.load(std::memory_order_relaxed) + 1;
+        nodes.store(count, std::memory_order_relaxed);
+
+        // node limited searches are single threaded, the limit is exact
+        if (count >= manager->nodeLimit)
+        {
+            manager->stop();
+        }
+    }
+
+    void SearchWorker::countQNode()
+    {
+        qNodes.store(qNodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // The move raised alpha, so the variation of this ply becomes the move
+    // followed by the variation found by the search of its reply
+    void SearchWorker::updatePv(int ply, Move move)
+    {
+        pvTable[ply][ply] = move;
+        for (int i = ply + 1; i < pvLength[ply + 1]; i++)
+        {
+            pvTable[ply][i] = pvTable[ply + 1][i];
+        }
+        pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+    }
 
-        Depth depth = 1;
-        auto begin = std::chrono::steady_clock::now();
+    void SearchWorker::iterativeDeepening(Position pos, Depth maxDepth)
+    {
+        // half of the helpers start one ply deeper, so that the threads
+        // don't all work on the same iteration at the same time
+        Depth depth = 1 + id % 2;
+        Eval score = 0;
         while (true)
         {
-            search(pos, depth, 0, MIN_EVAL, MAX_EVAL, false);
-            auto time = getTimeMs(begin, std::chrono::steady_clock::now());
-            if (listener != NULL)
+            rootDepth = depth;
+            selDepth = 0;
+
+            // search a window around the score of the previous iteration,
+            // widening it on the side where the score falls outside
+            int delta = ASPIRATION_WINDOW;
+            int alpha = MIN_EVAL;
+            int beta = MAX_EVAL;
+            if (depth >= ASPIRATION_MIN_DEPTH && std::abs(score) < MATE_THRESHOLD)
             {
-                listener->onSearchInfo(depth, nodes, time, TT.getOccupancyRate());
+                alpha = std::max(score - delta, int(MIN_EVAL));
+                beta = std::min(score + delta, int(MAX_EVAL));
             }
-            if (depth >= maxDepth || shouldStop(thinkInfo, depth, nodes, endTime))
+
+            while (true)
+            {
+                score = search(pos, depth, 0, alpha, beta, false);
+                if (shouldStop())
+                {
+                    break;
+                }
+
+                // a bound already at its limit can't be widened, the score is
+                // final, as for a mated root
+                if (score <= alpha && alpha > MIN_EVAL)
+                {
+                    failLows++;
+                    if (id == 0)
+                    {
+                        manager->onIterationComplete(depth, score, UPPER_BOUND);
+                    }
+                    beta = (alpha + beta) / 2;
+                    alpha = std::max(score - delta, int(MIN_EVAL));
+                }
+                else if (score >= beta && beta < MAX_EVAL)
+                {
+                    failHighs++;
+                    if (id == 0)
+                    {
+                        manager->onIterationComplete(depth, score, LOWER_BOUND);
+                    }
+                    beta = std::min(score + delta, int(MAX_EVAL));
+                }
+                else
+                {
+                    break;
+                }
+                delta += delta / 2;
+            }
+
+            if (id == 0 && !shouldStop())
+            {
+                manager->onIterationComplete(depth, score, EXACT);
+            }
+            if (depth >= maxDepth || shouldStop() ||
+                (id == 0 && manager->timeManager.shouldStopAfterIteration(moveToMake, score)))
             {
                 break;
             }
             depth += 1;
         }
-        int64_t totalTime = getTimeMs(begin, std::chrono::steady_clock::now());
+    }
+
+    SearchManager::SearchManager(size_t hashMegabytes) : TT{TranspositionTable(hashMegabytes)}, stopped{false}, nodeLimit{UINT64_MAX},
+                                     listener{NULL}
+    {
+        setThreads(1);
+    }
+
+    void SearchManager::setListener(SearchListener *listener)
+    {
+        this->listener = listener;
+    }
+
+    void SearchManager::setThreads(int count)
+    {
+        count = std::clamp(count, 1, MAX_THREADS);
+        workers.clear();
+        for (int i = 0; i < count; i++)
+        {
+            workers.push_back(std::make_unique<SearchWorker>(this, i));
+        }
+    }
+
+    int SearchManager::getThreads() const
+    {
+        return workers.size();
+    }
+
+    void SearchManager::setHashSize(size_t megabytes)
+    {
+        TT.resize(megabytes);
+    }
+
+    void SearchManager::clear()
+    {
+        TT.clear(workers.size());
+        for (auto &worker : workers)
+        {
+            worker->clear();
+        }
+    }
+
+    // The thread that hands a search over to the search thread clears the
+    // flag and sets the ponder state before doing so, so that a stop or a
+    // ponder hit sent right after is never lost
+    void SearchManager::resetStop(bool ponder)
+    {
+        stopped = false;
+        timeManager.setPondering(ponder);
+    }
+
+    void SearchManager::ponderHit()
+    {
+        if (timeManager.ponderHit())
+        {
+            stop();
+        }
+    }
+
+    void SearchManager::stop()
+    {
+        stopped.store(true, std::memory_order_relaxed);
+    }
+
+    void SearchManager::pollClock()
+    {
+        if (timeManager.isHardLimitReached())
+        {
+            stop();
+        }
+    }
+
+    // Search with the limits of a go command, resetStop must have been called
+    void SearchManager::startSearch(Position &pos, ThinkInfo *info, SearchDiagnostic *sc)
+    {
+        timeManager.start(*info, pos.getTurn());
+        nodeLimit = info->flags & F_NODES ? info->nodes : UINT64_MAX;
+        Depth maxDepth = info->flags & F_DEPTH ? std::clamp<int>(info->depth, 1, MAX_DEPTH) : MAX_DEPTH;
+
+        Move bestMove = runSearch(pos, maxDepth, sc);
+
+        timeManager.clear();
+        nodeLimit = UINT64_MAX;
+        listener->onSearchComplete(bestMove, getPonderMove(pos, bestMove));
+    }
+
+    // The reply expected by the principal variation, or by the TT when
+    // the variation is cut short
+    Move SearchManager::getPonderMove(const Position &pos, Move bestMove) const
+    {
+        const SearchWorker &main = *workers[0];
+        if (main.rootPvLength > 1 && main.rootPv[0] == bestMove)
+        {
+            return main.rootPv[1];
+        }
+        if (!bestMove.isValid())
+        {
+            return Move();
+        }
+
+        Position next = pos;
+        RevertState state;
+        next.makeTurn(bestMove, &state);
+        TTEntry entry;
+        if (TT.get(next.getZobristKey(), entry) && isPseudoLegal(next, entry.hashMove) &&
+            isLegal(next, entry.hashMove))
+        {
+            return entry.hashMove;
+        }
+        return Move();
+    }
+
+    Move SearchManager::runIterativeDeepening(Position &pos, Depth maxDepth, SearchDiagnostic *sc)
+    {
+        resetStop();
+        return runSearch(pos, maxDepth, sc);
+    }
+
+    Move SearchManager::runSearch(Position &pos, Depth maxDepth, SearchDiagnostic *sc)
+    {
+        // the search state is kept between moves, the TT entries
+        // are aged and the history scores are decayed instead
+        for (auto &worker : workers)
+        {
+            worker->newSearch();
+        }
+        TT.newSearch();
+
+        startTime = std::chrono::steady_clock::now();
+
+        // node limited searches stay single threaded, so that the limit is exact
+        std::vector<std::thread> helpers;
+        if (nodeLimit == UINT64_MAX)
+        {
+            for (size_t i = 1; i < workers.size(); i++)
+            {
+                helpers.emplace_back(&SearchWorker::iterativeDeepening,
+                                     workers[i].get(), pos, MAX_DEPTH);
+            }
+        }
+
+        SearchWorker &main = *workers[0];
+        main.iterativeDeepening(pos, maxDepth);
+
+        // the best move can't be sent while pondering, even when the search
+        // is done, so the helpers go on until the ponder hit or the stop
+        while (timeManager.isPondering() && !stopped.load(std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        stop();
+        for (auto &helper : helpers)
+        {
+            helper.join();
+        }
+        int64_t totalTime = getTimeMs(startTime, std::chrono::steady_clock::now());
 
         if (sc != NULL)
         {
-            sc->depth = depth;
-            sc->nodes = nodes;
-            sc->qNodes = qNodes;
+            sc->depth = main.rootDepth;
+            sc->nodes = 0;
+            sc->qNodes = 0;
+            sc->cutOffs = 0;
+            sc->failLows = 0;
+            sc->failHighs = 0;
+            sc->moveCutOffs = 0;
+            sc->firstMoveCutOffs = 0;
+            sc->quietGenerations = 0;
+            sc->ttAccesses = 0;
+            sc->ttHits = 0;
+            sc->pawnAccesses = 0;
+            sc->pawnHits = 0;
+            for (auto &worker : workers)
+            {
+                sc->nodes += worker->getNodes();
+                sc->qNodes += worker->getQNodes();
+                sc->cutOffs += worker->cutOffs;
+                sc->failLows += worker->failLows;
+                sc->failHighs += worker->failHighs;
+                sc->moveCutOffs += worker->moveCutOffs;
+                sc->firstMoveCutOffs += worker->firstMoveCutOffs;
+                sc->quietGenerations += worker->quietGenerations;
+                sc->ttAccesses += worker->ttAccesses;
+                sc->ttHits += worker->ttHits;
+                sc->pawnAccesses += worker->pawnTable.getAccesses();
+                sc->pawnHits += worker->pawnTable.getHits();
+            }
             sc->timeMs = totalTime;
-            sc->cutOffs = cutOffs;
-            sc->ttAccesses = ttAccesses;
-            sc->ttHits = ttHits;
             sc->ttOccupancy = TT.getOccupancyRate();
         }
 
-        return moveToMake;
+        // stopped before the first iteration completed, any legal move is better than none
+        if (!main.moveToMake.isValid())
+        {
+            MoveList moveList;
+            generateMoves<ALL>(pos, moveList);
+            return moveList.size > 0 ? moveList.moves[0] : Move();
+        }
+        return main.moveToMake;
+    }
+
+    uint64_t SearchManager::getTotalNodes() const
+    {
+        uint64_t total = 0;
+        for (auto &worker : workers)
+        {
+            total += worker->getNodes();
+        }
+        return total;
+    }
+
+    void SearchManager::onIterationComplete(Depth depth, Eval score, NodeType bound)
+    {
+        if (listener == NULL)
+        {
+            return;
+        }
+
+        SearchWorker &main = *workers[0];
+        SearchInfo info;
+        info.depth = depth;
+        info.selDepth = main.selDepth;
+        info.score = score;
+        info.bound = bound;
+        info.nodes = 0;
+        info.qNodes = 0;
+        for (auto &worker : workers)
+        {
+            info.nodes += worker->getNodes();
+            info.qNodes += worker->getQNodes();
+        }
+        info.timeMs = getTimeMs(startTime, std::chrono::steady_clock::now());
+        info.ttOccupancy = TT.getOccupancyRate();
+        info.pv.assign(main.rootPv, main.rootPv + main.rootPvLength);
+        listener->onSearchInfo(info);
     }
 
-    Eval SearchManager::search(Position &pos, Depth depth, int ply,
+    Eval SearchWorker::search(Position &pos, Depth depth, int ply,
                                Eval alpha, Eval beta, bool canNull)
     {
-        if (shouldStop(thinkInfo, 0, nodes, endTime))
+        pvLength[ply] = ply;
+        selDepth = std::max(selDepth, ply);
+
+        if (shouldStop())
         {
             return 0;
         }
 
         if (pos.getHalfMove() >= 100 || pos.isRepeated())
         {
-            nodes++;
+            countNode();
             return 0;
         }
 
         if (depth <= 0)
         {
-            return quiescenceSearch(pos, alpha, beta);
+            return quiescenceSearch(pos, ply, alpha, beta);
+        }
+
+        // a drawn endgame is cut off, a won one is still searched to find the mate
+        Eval bitbaseEval;
+        if (ply > 0 && bitbase::probe(pos, bitbaseEval) && bitbaseEval == 0)
+        {
+            countNode();
+            return 0;
         }
 
         Eval originalAlpha = alpha;
-        TTEntry *entry = TT.get(pos.getZobristKey());
+        TTEntry entry;
+        bool ttHit = manager->TT.get(pos.getZobristKey(), entry);
         ttAccesses++;
-        if (ply > 0 && entry != NULL && entry->depth >= depth)
+        // the principal variation isn't cut short by the TT, so it's reported whole
+        bool pvNode = beta - alpha > 1;
+        if (ply > 0 && ttHit && entry.depth >= depth && !pvNode)
         {
             ttHits++;
-            if (entry->type == EXACT)
+            Eval ttEval = scoreFromTT(entry.eval, ply);
+            if (entry.type == EXACT)
             {
-                nodes++;
-                return entry->eval;
+                countNode();
+                return ttEval;
             }
-            else if (entry->type == LOWER_BOUND)
+            else if (entry.type == LOWER_BOUND)
             {
-                alpha = std::max(alpha, entry->eval);
+                alpha = std::max(alpha, ttEval);
             }
-            else if (entry->type == UPPER_BOUND)
+            else if (entry.type == UPPER_BOUND)
             {
-                beta = std::min(beta, entry->eval);
+                beta = std::min(beta, ttEval);
             }
 
             if (alpha >= beta)
             {
-                nodes++;
-                return entry->eval;
-            }
-        }
-
-        MoveList moveList;
-        generateMoves<ALL>(pos, moveList);
-
-        if (moveList.size == 0)
-        {
-            nodes++;
-            if (pos.isKingInCheck())
-            {
-                return MIN_EVAL + ply;
-            }
-            else
-            {
-                return 0;
+                countNode();
+                return ttEval;
             }
         }
 
@@ -165,29 +521,66 @@ namespace engine
             if (eval >= beta)
             {
                 cutOffs++;
-                return beta;
+                // a mate found after passing isn't proven
+                return eval >= MATE_THRESHOLD ? beta : eval;
             }
         }
 
-        ExtMoveList extMoveList = ExtMoveList(moveList);
-        Move hashMove = ply == 0
+        Move hashMove = ply == 0 && moveToMake.isValid()
                             ? moveToMake
-                        : entry != NULL
-                            ? entry->hashMove
+                        : ttHit
+                            ? entry.hashMove
                             : Move();
-        scoreMoves(pos, extMoveList, hashMove, &killers[ply]);
+        MovePicker picker(pos, hashMove, killers[ply], history[pos.getTurn()]);
 
         Eval bestEval = MIN_EVAL;
         Move bestMove = Move();
+        int movesSearched = 0;
+
+        bool inCheck = pos.isKingInCheck();
 
-        while (extMoveList.size > 0)
+        for (Move move = picker.next(); move.isValid(); move = picker.next())
         {
-            Move move = popMoveHighestScore(extMoveList);
+            movesSearched++;
+            bool quiet = !move.isCapture() && !move.isPromotion();
+            int moveHistory = history[pos.getTurn()][move.getFrom()][move.getTo()];
+            bool killer = killers[ply].matchA(move) || killers[ply].matchB(move);
+
             pos.makeTurn(move, &state);
-            eval = -search(pos, depth - 1, ply + 1, -beta, -alpha, true);
+            if (movesSearched == 1)
+            {
+                eval = -search(pos, depth - 1, ply + 1, -beta, -alpha, true);
+            }
+            else
+            {
+                // late quiet moves are searched with a reduced depth, less so
+                // on the principal variation and for moves that caused cut-offs
+                int reduction = 0;
+                if (depth >= LMR_MIN_DEPTH && movesSearched >= LMR_MIN_MOVES && quiet &&
+                    !inCheck && !pos.isKingInCheck())
+                {
+                    reduction = reductions[depth][std::min(movesSearched, 63)];
+                    reduction -= pvNode;
+                    reduction -= killer;
+                    reduction -= moveHistory / LMR_HISTORY_DIVISOR;
+                    reduction = std::clamp(reduction, 0, depth - 2);
+                }
+
+                // the other moves only have to be proven worse than the best one,
+                // which a zero window search does faster
+                eval = -search(pos, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha, true);
+                if (eval > alpha && reduction > 0)
+                {
+                    eval = -search(pos, depth - 1, ply + 1, -alpha - 1, -alpha, true);
+                }
+                if (eval > alpha && eval < beta)
+                {
+                    eval = -search(pos, depth - 1, ply + 1, -beta, -alpha, true);
+                }
+            }
             pos.unmakeTurn();
 
-            if (shouldStop(thinkInfo, 0, nodes, endTime))
+            if (shouldStop())
             {
                 return 0;
             }
@@ -196,12 +589,18 @@ namespace engine
             {
                 bestEval = eval;
                 bestMove = move;
+                if (eval > alpha)
+                {
+                    updatePv(ply, move);
+                }
             }
 
             alpha = std::max(alpha, eval);
             if (alpha >= beta)
             {
                 cutOffs++;
+                moveCutOffs++;
+                firstMoveCutOffs += movesSearched == 1;
                 if (!move.isCapture())
                 {
                     killers[ply].add(move);
@@ -210,6 +609,13 @@ namespace engine
                 break;
             }
         }
+        quietGenerations += picker.getStage() >= PICK_QUIETS;
+
+        if (movesSearched == 0)
+        {
+            countNode();
+            return pos.isKingInCheck() ? MIN_EVAL + ply : 0;
+        }
 
         NodeType type = EXACT;
         if (bestEval >= beta)
@@ -220,44 +626,54 @@ namespace engine
         {
             type = UPPER_BOUND;
         }
-        TT.add(pos.getZobristKey(), depth, type, bestMove, bestEval);
+        manager->TT.add(pos.getZobristKey(), depth, type, bestMove, scoreToTT(bestEval, ply));
 
-        if (ply == 0)
+        // when every root move fails low their scores are only upper bounds,
+        // so the best move of the previous iteration is kept
+        if (ply == 0 && (bestEval > originalAlpha || !moveToMake.isValid()))
         {
             moveToMake = bestMove;
+            rootPvLength = std::max(pvLength[0], 1);
+            std::copy(pvTable[0] + 1, pvTable[0] + rootPvLength, rootPv + 1);
+            rootPv[0] = bestMove;
         }
         return bestEval;
     }
 
-    Eval SearchManager::quiescenceSearch(Position &pos, Eval alpha, Eval beta)
+    Eval SearchWorker::quiescenceSearch(Position &pos, int ply, Eval alpha, Eval beta)
     {
-        if (shouldStop(thinkInfo, 0, nodes, endTime))
+        if (shouldStop())
         {
             return 0;
         }
+        selDepth = std::max(selDepth, ply);
 
-        Eval standPat = evaluate(pos);
+        Eval bitbaseEval;
+        if (bitbase::probe(pos, bitbaseEval))
+        {
+            countNode();
+            countQNode();
+            return bitbaseEval;
+        }
+
+        // fail-soft, the bounds returned are as tight as the search allows
+        Eval standPat = evaluate(pos, pawnTable);
         if (standPat >= beta)
         {
-            nodes++;
-            qNodes++;
+            countNode();
+            countQNode();
             cutOffs++;
-            return beta;
+            return standPat;
         }
         alpha = std::max(alpha, standPat);
+        Eval bestEval = standPat;
 
-        MoveList moveList;
-        generateMoves<CAPTURES>(pos, moveList);
-
-        ExtMoveList extMoveList(moveList);
-        scoreMoves(pos, extMoveList, Move());
+        MovePicker picker(pos);
 
         Eval eval;
         RevertState state;
-        while (extMoveList.size > 0)
+        for (Move move = picker.next(); move.isValid(); move = picker.next())
         {
-            Move move = popMoveHighestScore(extMoveList);
-
             // todo don't do delta pruning in endgame
             if (!move.isPromotion() &&
                 standPat + getPieceEval(typeOf(pos.getPiece(move.getTo()))) + 200 < alpha)
@@ -265,11 +681,17 @@ namespace engine
                 continue;
             }
 
+            // a capture that loses material can't raise alpha over the stand pat
+            if (!see(pos, move, 0))
+            {
+                continue;
+            }
+
             pos.makeTurn(move, &state);
-            eval = -quiescenceSearch(pos, -beta, -alpha);
+            eval = -quiescenceSearch(pos, ply + 1, -beta, -alpha);
             pos.unmakeTurn();
 
-            if (shouldStop(thinkInfo, 0, nodes, endTime))
+            if (shouldStop())
             {
                 return 0;
             }
@@ -277,61 +699,12 @@ namespace engine
             if (eval >= beta)
             {
                 cutOffs++;
-                return beta;
+                return eval;
             }
+            bestEval = std::max(bestEval, eval);
             alpha = std::max(alpha, eval);
         }
 
-        return alpha;
-    }
-
-    void SearchManager::scoreMoves(Position &pos, ExtMoveList &moveList, Move hashMove, Killers *k)
-    {
-        for (size_t i = 0; i < moveList.size; i++)
-        {
-            moveList.moves[i].score = moveList.moves[i] == hashMove
-                                          ? TT_SCORE
-                                          : scoreMove(pos, moveList.moves[i], k);
-        }
-    }
-
-    int SearchManager::scoreMove(Position &pos, Move &move, Killers *k)
-    {
-        int score = 0;
-        Piece piece = pos.getPiece(move.getFrom());
-        Piece captured = pos.getPiece(move.getTo());
-        if (move.isPromotion())
-        {
-            score += PROM_SCORE;
-        }
-        score += MVV_LVA[typeOf(captured)][typeOf(piece)];
-        if (captured == NULL_PIECE)
-        {
-            if (k != NULL && k->matchA(move))
-            {
-                score += KILLER_SCORE_A;
-            }
-            else if (k != NULL && k->matchB(move))
-            {
-                score += KILLER_SCORE_B;
-            }
-            score += history[pos.getTurn()][move.getFrom()][move.getTo()];
-        }
-        return score;
-    }
-
-    Move SearchManager::popMoveHighestScore(ExtMoveList &moveList)
-    {
-        assert(moveList.size > 0);
-        size_t moveIndex = 0;
-        for (size_t j = 1; j < moveList.size; j++)
-        {
-            if (moveList.moves[j].score > moveList.moves[moveIndex].score)
-                moveIndex = j;
-        }
-        Move move = moveList.moves[moveIndex];
-        moveList.moves[moveIndex] = moveList.moves[moveList.size - 1];
-        moveList.size--;
-        return move;
+        return bestEval;
     }
 }
@@ -2,10 +2,15 @@
 #define SEARCH_H
 
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include "transposition.hpp"
 #include "evaluation.hpp"
+#include "pawns.hpp"
 #include "position.hpp"
 #include "generator.hpp"
+#include "movepicker.hpp"
 #include "time.hpp"
 #include "listeners.hpp"
 #include "move.hpp"
@@ -13,40 +18,27 @@
 namespace engine
 {
     constexpr Depth MAX_DEPTH = 100;
+    // the main search can't go deeper than its depth, the quiescence search can
+    constexpr int MAX_PLY = MAX_DEPTH + 1;
+    constexpr int MAX_THREADS = 1024;
 
-    constexpr int TT_SCORE = 1000000000;
-    constexpr int PROM_SCORE = 100000000;
-    constexpr int KILLER_SCORE_A = 8000000;
-    constexpr int KILLER_SCORE_B = 5000000;
-
-    // victim - attacker
-    constexpr int MVV_LVA[7][7] = {
-        {0, 0, 0, 0, 0, 0, 0},
-        {0, 15000000, 14000000, 13000000, 12000000, 11000000, 10000000}, // P->P, N->P, B->P, R->P, Q->P, K->P
-        {0, 25000000, 24000000, 23000000, 22000000, 21000000, 20000000}, // P->N, N->N, B->N, R->N, Q->N, K->N
-        {0, 35000000, 34000000, 33000000, 32000000, 31000000, 30000000}, // P->B, N->B, B->B, R->B, Q->B, K->B
-        {0, 45000000, 44000000, 43000000, 42000000, 41000000, 40000000}, // P->R, N->R, B->R, R->R, Q->R, K->R
-        {0, 55000000, 54000000, 53000000, 52000000, 51000000, 50000000}, // P->P, N->P, B->P, R->P, Q->P, K->P
-        {0, 0, 0, 0, 0, 0, 0},
-    };
+    // history scores are divided by this at the start of every search
+    constexpr int HISTORY_DECAY = 2;
 
-    struct ExtendedMove : Move
-    {
-        int score;
-        void operator=(Move m) { data = m.raw(); }
-    };
+    // late move reductions start after LMR_MIN_MOVES moves at LMR_MIN_DEPTH,
+    // one ply less is reduced for every LMR_HISTORY_DIVISOR of history score
+    constexpr Depth LMR_MIN_DEPTH = 3;
+    constexpr int LMR_MIN_MOVES = 3;
+    constexpr double LMR_BASE = 0.75;
+    constexpr double LMR_DIVISOR = 2.25;
+    constexpr int LMR_HISTORY_DIVISOR = 4096;
 
-    struct ExtMoveList
-    {
-        ExtendedMove moves[maxMoves];
-        size_t size;
-
-        ExtMoveList(MoveList moveList) : size{moveList.size}
-        {
-            for (size_t i = 0; i < moveList.size; i++)
-                moves[i] = moveList.moves[i];
-        };
-    };
+    // the main thread polls the clock once every this many stop checks
+    constexpr int CLOCK_POLL_INTERVAL = 1024;
+
+    // half width of the first aspiration window, it grows by half on every fail
+    constexpr int ASPIRATION_WINDOW = 25;
+    constexpr Depth ASPIRATION_MIN_DEPTH = 4;
 
     struct SearchDiagnostic
     {
@@ -55,67 +47,109 @@ namespace engine
         uint64_t qNodes;
         uint64_t timeMs;
         uint64_t cutOffs;
+        uint64_t failLows;
+        uint64_t failHighs;
+        uint64_t moveCutOffs;
+        uint64_t firstMoveCutOffs;
+        uint64_t quietGenerations;
         uint64_t ttAccesses;
         uint64_t ttHits;
         float ttOccupancy;
+        uint64_t pawnAccesses;
+        uint64_t pawnHits;
     };
 
-    struct Killers
-    {
-        Move moveA;
-        Move moveB;
-
-        void add(Move move)
-        {
-            if (move != moveA)
-            {
-                moveB = moveA;
-                moveA = move;
-            }
-        }
-
-        bool matchA(Move move)
-        {
-            return move == moveA;
-        }
-        bool matchB(Move move)
-        {
-            return move == moveB;
-        }
-    };
+    class SearchManager;
 
-    class SearchManager
+    // State owned by a single search thread. With Lazy SMP every thread searches
+    // the same root with its own killers and history, sharing only the TT.
+    class SearchWorker
     {
+        friend class SearchManager;
+
     private:
-        TranspositionTable TT;
+        SearchManager *manager;
+        int id;
+
         Killers killers[MAX_DEPTH + 1];
         int history[2][64][64];
+        PawnTable pawnTable;
+
+        // triangular table, the row of a ply holds the principal variation
+        // found at that ply so far, starting at the diagonal
+        Move pvTable[MAX_PLY][MAX_PLY];
+        int pvLength[MAX_PLY];
+        Move rootPv[MAX_PLY];
+        int rootPvLength;
 
         Move moveToMake;
-        uint64_t nodes;
-        uint64_t qNodes;
+        Depth rootDepth;
+        int selDepth;
+        int checksToClockPoll;
+        std::atomic<uint64_t> nodes;
+        std::atomic<uint64_t> qNodes;
         uint64_t cutOffs;
+        uint64_t failLows;
+        uint64_t failHighs;
+        uint64_t moveCutOffs;
+        uint64_t firstMoveCutOffs;
+        uint64_t quietGenerations;
         uint64_t ttAccesses;
         uint64_t ttHits;
 
-        ThinkInfo *thinkInfo;
+        void resetStats();
+        bool shouldStop();
+        void countNode();
+        void countQNode();
+        void updatePv(int ply, Move move);
+        Eval search(Position &pos, Depth depth, int ply, Eval alpha, Eval beta, bool canNull);
+        Eval quiescenceSearch(Position &pos, int ply, Eval alpha, Eval beta);
+
+    public:
+        SearchWorker(SearchManager *manager, int id);
+
+        void clear();
+        void newSearch();
+        void iterativeDeepening(Position pos, Depth maxDepth);
+        uint64_t getNodes() const;
+        uint64_t getQNodes() const;
+    };
+
+    class SearchManager
+    {
+        friend class SearchWorker;
+
+    private:
+        TranspositionTable TT;
+        std::vector<std::unique_ptr<SearchWorker>> workers;
+
+        // set by the time or node limit, by the main thread when it's done
+        // so that the helpers end, or by stop from another thread
+        std::atomic<bool> stopped;
+        uint64_t nodeLimit;
+        TimeManager timeManager;
         std::chrono::_V2::steady_clock::time_point startTime;
-        std::chrono::_V2::steady_clock::time_point endTime;
 
         SearchListener *listener;
 
-        Eval search(Position &pos, Depth depth, int ply, Eval alpha, Eval beta, bool canNull);
-        Eval quiescenceSearch(Position &pos, Eval alpha, Eval beta);
-        void scoreMoves(Position &pos, ExtMoveList &moveList, Move hashMove, Killers *k = NULL);
-        int scoreMove(Position &pos, Move &move, Killers *k = NULL);
-        Move popMoveHighestScore(ExtMoveList &moveList);
+        void pollClock();
+        Move runSearch(Position &pos, Depth maxDepth, SearchDiagnostic *sc);
+        Move getPonderMove(const Position &pos, Move bestMove) const;
+        uint64_t getTotalNodes() const;
+        void onIterationComplete(Depth depth, Eval score, NodeType bound);
 
     public:
-        SearchManager();
+        SearchManager(size_t hashMegabytes = DEFAULT_HASH_MB);
 
         void setListener(SearchListener *listener);
+        void setThreads(int count);
+        int getThreads() const;
+        void setHashSize(size_t megabytes);
         void clear();
-        void startSearch(Position &pos, ThinkInfo *info);
+        void resetStop(bool ponder = false);
+        void stop();
+        void ponderHit();
+        void startSearch(Position &pos, ThinkInfo *info, SearchDiagnostic *sc = NULL);
         Move runIterativeDeepening(Position &pos, Depth maxDepth = MAX_DEPTH,
                                    SearchDiagnostic *sc = NULL);
     };
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include "server.hpp"
+
+namespace engine
+{
+    GameSession::GameSession(GameServer *server, const std::string &id, size_t hashMegabytes)
+        : UCIEngine(false, hashMegabytes), server{server}, id{id}, closed{false}, ponderWaiting{false},
+          searching{false}
+    {
+    }
+
+    void GameSession::respond(std::string message)
+    {
+        if (!closed.load(std::memory_order_relaxed))
+            server->write(id + " " + message);
+    }
+
+    void GameSession::setOption(const std::string &name, const std::string &value)
+    {
+        if (name == "Hash" || name == "Threads" || name == "BitbaseFile" || name == "Ponder")
+            respond("info string " + name + " is set by the server");
+        else
+            UCIEngine::setOption(name, value);
+    }
+
+    bool GameSession::processCommand(const std::string &command)
+    {
+        std::istringstream iss(command);
+        std::string token, goToken;
+        iss >> token >> goToken;
+        if (searching && (token == "go" || token == "position" || token == "ucinewgame"))
+        {
+            respond("info string " + token + " is refused until the bestmove of the search");
+            return true;
+        }
+        // perft runs on the input thread, it would hold up every other game
+        if (token == "go" && goToken == "perft")
+        {
+            respond("info string perft is not available on the server");
+            return true;
+        }
+        return UCIEngine::processCommand(command);
+    }
+
+    // A pondering search would hold its worker until the ponder hit, so it
+    // waits here instead and then runs as a normal search on the clock
+    void GameSession::startThinking(const ThinkInfo &info)
+    {
+        searching = true;
+        ponderWaiting = info.task == PONDER;
+        if (ponderWaiting)
+        {
+            ponderInfo = info;
+            ponderInfo.task = SEARCH;
+            return;
+        }
+        bot.startThinking(info);
+        server->schedule(shared_from_this());
+    }
+
+    void GameSession::stopThinking()
+    {
+        if (ponderWaiting)
+            startThinking(ponderInfo);
+        bot.stopThinking();
+    }
+
+    void GameSession::ponderHit()
+    {
+        if (ponderWaiting)
+            startThinking(ponderInfo);
+        else
+            bot.ponderHit();
+    }
+
+    void GameSession::onMoveChosen(std::string move, std::string ponderMove)
+    {
+        bestMove = move;
+        this->ponderMove = ponderMove;
+    }
+
+    // The next go may come as soon as the bestmove is sent, so it is sent
+    // only once the search is done
+    void GameSession::think()
+    {
+        bot.think();
+        searching = false;
+        UCIEngine::onMoveChosen(bestMove, ponderMove);
+    }
+
+    void GameSession::close()
+    {
+        closed = true;
+        bot.stopThinking();
+    }
+
+    GameServer::GameServer(int threads, size_t maxSessions, size_t hashMegabytes,
+                           std::function<void(const std::string &)> output)
+        : maxSessions{std::max<size_t>(maxSessions, 1)},
+          sessionHashMegabytes{std::max<size_t>(hashMegabytes / std::max<size_t>(maxSessions, 1), 1)},
+          stopping{false}, output{output}
+    {
+        for (int i = 0; i < std::max(threads, 1); i++)
+        {
+            workers.emplace_back(&GameServer::runWorker, this);
+        }
+    }
+
+    GameServer::~GameServer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            for (auto &[id, session] : sessions)
+            {
+                session->close();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void GameServer::loop()
+    {
+        std::string line;
+        while (std::getline(std::cin, line) && processLine(line))
+        {
+        }
+    }
+
+    bool GameServer::processLine(const std::string &line)
+    {
+        std::istringstream iss(line);
+        std::string id, command;
+        iss >> id;
+        std::getline(iss >> std::ws, command);
+        if (id.empty())
+            return true;
+        if (id == "quit" && command.empty())
+            return false;
+
+        std::shared_ptr<GameSession> session;
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            auto it = sessions.find(id);
+            if (it != sessions.end())
+            {
+                session = it->second;
+            }
+            else if (sessions.size() < maxSessions)
+            {
+                session = std::make_shared<GameSession>(this, id, sessionHashMegabytes);
+                sessions[id] = session;
+            }
+        }
+        if (session == NULL)
+        {
+            write(id + " info string the server is full with " + std::to_string(maxSessions) + " games");
+            return true;
+        }
+
+        // a search still running after quit ends without a response
+        if (!session->processCommand(command))
+        {
+            session->close();
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            sessions.erase(id);
+        }
+        return true;
+    }
+
+    size_t GameServer::getSessionCount()
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex);
+        return sessions.size();
+    }
+
+    size_t GameServer::getSessionHashSize() const
+    {
+        return sessionHashMegabytes;
+    }
+
+    void GameServer::schedule(std::shared_ptr<GameSession> session)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(session);
+        }
+        queueCondition.notify_one();
+    }
+
+    // The queue keeps a session alive until its search is done, even
+    // when the game has ended in the meantime
+    void GameServer::runWorker()
+    {
+        while (true)
+        {
+            std::shared_ptr<GameSession> session;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this]
+                                    { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                session = queue.front();
+                queue.pop_front();
+            }
+            session->think();
+        }
+    }
+
+    void GameServer::write(const std::string &line)
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if (output)
+            output(line);
+        else
+            std::cout << line << std::endl;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "uci.hpp"
+
+namespace engine
+{
+    constexpr size_t DEFAULT_SERVER_SESSIONS = 16;
+    constexpr size_t DEFAULT_SERVER_HASH_MB = 256;
+
+    class GameServer;
+
+    /**
+     * One game of the server: a UCI engine without a think thread, whose
+     * searches are queued to the workers of the server. The hash and the
+     * threads are set by the server, so their options are refused, and so
+     * is go perft, which would run on the input thread of the server.
+     * Pondering is refused too: a go ponder holds no worker, its search is
+     * only queued on the ponder hit, or on the stop to answer with a move at
+     * once. Until the bestmove is sent, the commands that would start
+     * another search or change the position under the running one are
+     * refused.
+     */
+    class GameSession : public UCIEngine, public std::enable_shared_from_this<GameSession>
+    {
+    private:
+        GameServer *server;
+        std::string id;
+        std::atomic<bool> closed;
+
+        // the search of a go ponder, waiting for the ponder hit or the stop
+        ThinkInfo ponderInfo;
+        bool ponderWaiting;
+
+        // set by go until the bestmove is sent, which waits for the search
+        // to be done with the position
+        std::atomic<bool> searching;
+        std::string bestMove;
+        std::string ponderMove;
+
+    protected:
+        void respond(std::string message) override;
+        void setOption(const std::string &name, const std::string &value) override;
+        void startThinking(const ThinkInfo &info) override;
+        void stopThinking() override;
+        void ponderHit() override;
+
+    public:
+        GameSession(GameServer *server, const std::string &id, size_t hashMegabytes);
+
+        bool processCommand(const std::string &command) override;
+        void onMoveChosen(std::string move, std::string ponderMove) override;
+        void think();
+        // nothing is sent anymore, a queued or running search stops at once
+        void close();
+    };
+
+    /**
+     * Many games in one process, multiplexed over one stream of lines: each
+     * command starts with the id of its game, and so does each response. A
+     * game starts with its first command and ends with quit. The searches
+     * run on a fixed pool of workers, one thread each, and the hash budget
+     * is split evenly over the maximum number of games. The attack tables
+     * and the bitbases are global, so the games share them.
+     */
+    class GameServer
+    {
+        friend class GameSession;
+
+    private:
+        size_t maxSessions;
+        size_t sessionHashMegabytes;
+
+        std::mutex sessionsMutex;
+        std::map<std::string, std::shared_ptr<GameSession>> sessions;
+
+        // sessions with a search to run, in the order of their go commands
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::deque<std::shared_ptr<GameSession>> queue;
+        bool stopping;
+        std::vector<std::thread> workers;
+
+        std::mutex outputMutex;
+        std::function<void(const std::string &)> output;
+
+        void runWorker();
+        void schedule(std::shared_ptr<GameSession> session);
+        void write(const std::string &line);
+
+    public:
+        // the output defaults to the standard output
+        GameServer(int threads, size_t maxSessions = DEFAULT_SERVER_SESSIONS,
+                   size_t hashMegabytes = DEFAULT_SERVER_HASH_MB,
+                   std::function<void(const std::string &)> output = NULL);
+        ~GameServer();
+
+        void loop();
+        // <game> <uci command>, or quit to end the server
+        bool processLine(const std::string &line);
+        size_t getSessionCount();
+        size_t getSessionHashSize() const;
+    };
+}
+
+#endif
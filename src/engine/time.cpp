@@ -1,44 +1,140 @@
+#include <algorithm>
+#include <cstdlib>
 #include "time.hpp"
+#include "evaluation.hpp"
+#include "misc.hpp"
 
 namespace engine
 {
-    uint64_t calcThinkTimeMs(ThinkInfo info, Color side)
+    TimeManager::TimeManager() : pondering{false}
     {
-        if (info.flags & (F_INFINITE | F_DEPTH | F_NODES))
-            return MAX_THINK_TIME_MS;
+        clear();
+    }
 
-        if (info.flags & F_MOVETIME)
-            return info.moveTime;
+    void TimeManager::clear()
+    {
+        limited = false;
+        adaptive = false;
+        startTime = std::chrono::steady_clock::now();
+        clockStartTime = startTime.load();
+        optimumMs = UINT64_MAX;
+        softLimitMs = hardLimitMs = 0;
+        lastBestMove = Move();
+        lastScore = 0;
+        stableIterations = 0;
+        lastIterationEnd = startTime.load();
+        lastIterationMs = 0;
+    }
 
-        uint64_t thinkTimeMs = 0;
-        int movesToGo = info.flags & F_MOVESTOGO
-                            ? info.movesToGo + 2
-                            : DEFAULT_MOVESTOGO;
+    void TimeManager::start(const ThinkInfo &info, Color side)
+    {
+        clear();
+        // a depth or node limit comes on top of the time limits
+        limited = !(info.flags & F_INFINITE) && (info.flags & (F_MOVETIME | F_TIME));
+        adaptive = limited && !(info.flags & F_MOVETIME);
 
-        if (info.flags & F_TIME)
-            thinkTimeMs += info.time[side] / movesToGo;
-        if (info.flags & F_INC)
-            thinkTimeMs += info.increment[side];
+        if (!limited)
+        {
+            softLimitMs = hardLimitMs = 0;
+        }
+        else if (!adaptive)
+        {
+            softLimitMs = hardLimitMs = std::max(info.moveTime, 0);
+        }
+        else
+        {
+            int movesToGo = info.flags & F_MOVESTOGO
+                                ? info.movesToGo + 2
+                                : DEFAULT_MOVESTOGO;
+            int increment = info.flags & F_INC ? info.increment[side] : 0;
+            uint64_t available = std::max(info.time[side] - MOVE_OVERHEAD_MS, 1);
 
-        return thinkTimeMs;
+            softLimitMs = available / movesToGo + increment;
+            hardLimitMs = std::min<uint64_t>(softLimitMs * HARD_LIMIT_SCALE,
+                                             available * HARD_LIMIT_CLOCK_SHARE);
+            hardLimitMs = std::max<uint64_t>(hardLimitMs, 1);
+            softLimitMs = std::min(softLimitMs, hardLimitMs);
+        }
     }
 
-    bool shouldStop(ThinkInfo *info, Depth depth, uint64_t nodes,
-                    std::chrono::_V2::steady_clock::time_point endTime)
+    // Set before the search is handed over to the search thread, so that
+    // a ponder hit that comes right after is never lost
+    void TimeManager::setPondering(bool pondering)
     {
-        if (info == NULL)
-            return false;
+        this->pondering = pondering;
+    }
+
+    // Called from another thread than the search, which sees the new clock
+    // start once it sees that pondering is over. Return true if the search
+    // has already used the time it would have without pondering
+    bool TimeManager::ponderHit()
+    {
+        auto now = std::chrono::steady_clock::now();
+        clockStartTime.store(now, std::memory_order_relaxed);
+        pondering.store(false, std::memory_order_release);
+        return (uint64_t)getTimeMs(startTime.load(std::memory_order_relaxed), now) >=
+               optimumMs.load(std::memory_order_relaxed);
+    }
+
+    bool TimeManager::isPondering() const
+    {
+        return pondering.load(std::memory_order_acquire);
+    }
 
-        if (info->task == NOTHING)
-            return true;
+    bool TimeManager::isHardLimitReached() const
+    {
+        return limited && !isPondering() &&
+               std::chrono::steady_clock::now() >=
+                   clockStartTime.load(std::memory_order_relaxed) + std::chrono::milliseconds(hardLimitMs);
+    }
+
+    // Called with the result of every completed iteration
+    bool TimeManager::shouldStopAfterIteration(Move bestMove, Eval score)
+    {
+        auto now = std::chrono::steady_clock::now();
+        bool ponder = isPondering();
+        uint64_t elapsed = getTimeMs(startTime.load(std::memory_order_relaxed), now);
+        uint64_t clockElapsed = getTimeMs(clockStartTime.load(std::memory_order_relaxed), now);
+        uint64_t iterationMs = getTimeMs(lastIterationEnd, now);
+
+        // the best move changing and the score dropping both mean that
+        // the search hasn't settled yet
+        stableIterations = bestMove == lastBestMove ? stableIterations + 1 : 0;
+        double scale = stabilityScale[std::min(stableIterations, 4)];
+        bool mateScores = std::abs(score) >= MATE_THRESHOLD || std::abs(lastScore) >= MATE_THRESHOLD;
+        if (lastBestMove.isValid() && !mateScores && score < lastScore)
+        {
+            scale *= 1.0 + 0.5 * std::min(lastScore - score, SCORE_DROP_MARGIN) / SCORE_DROP_MARGIN;
+        }
+
+        // the effective branching factor predicts how long the next iteration takes
+        double branchingFactor = lastIterationMs > 0
+                                     ? std::clamp((double)iterationMs / lastIterationMs,
+                                                  MIN_BRANCHING_FACTOR, MAX_BRANCHING_FACTOR)
+                                     : MIN_BRANCHING_FACTOR;
+        uint64_t nextIterationMs = iterationMs * branchingFactor;
 
-        if (info->flags & F_INFINITE)
+        lastBestMove = bestMove;
+        lastScore = score;
+        lastIterationEnd = now;
+        lastIterationMs = iterationMs;
+
+        if (!adaptive)
+        {
             return false;
-        if (info->flags & F_DEPTH)
-            return depth >= info->depth;
-        if (info->flags & F_NODES)
-            return nodes >= info->nodes;
+        }
+        uint64_t optimum = std::min<uint64_t>(softLimitMs * scale, hardLimitMs);
+        optimumMs.store(optimum, std::memory_order_relaxed);
+        return !ponder && (elapsed >= optimum || clockElapsed + nextIterationMs > hardLimitMs);
+    }
+
+    uint64_t TimeManager::getSoftLimitMs() const
+    {
+        return softLimitMs;
+    }
 
-        return std::chrono::steady_clock::now() >= endTime;
+    uint64_t TimeManager::getHardLimitMs() const
+    {
+        return hardLimitMs;
     }
 }
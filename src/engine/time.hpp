@@ -1,20 +1,77 @@
 #ifndef TIME_H
 #define TIME_H
 
+#include <atomic>
 #include <chrono>
+#include "move.hpp"
 #include "types.hpp"
 
 namespace engine
 {
-    constexpr uint64_t MAX_THINK_TIME_MS = 100000000;
-    constexpr uint64_t STD_THINK_TIME_MS = 100;
-
     constexpr int DEFAULT_MOVESTOGO = 30;
 
-    uint64_t calcThinkTimeMs(ThinkInfo info, Color side);
+    // kept on the clock for the communication with the GUI
+    constexpr int MOVE_OVERHEAD_MS = 20;
+
+    // the hard limit is this many times the soft limit,
+    // but never more than HARD_LIMIT_CLOCK_SHARE of the clock
+    constexpr int HARD_LIMIT_SCALE = 4;
+    constexpr double HARD_LIMIT_CLOCK_SHARE = 0.4;
+
+    // the soft limit is scaled by this after a number of iterations
+    // in a row with the same best move
+    constexpr double stabilityScale[5] = {1.6, 1.2, 1.0, 0.8, 0.65};
+
+    // a score drop of this many centipawns or more extends the soft limit
+    // by half, a smaller drop extends it proportionally
+    constexpr int SCORE_DROP_MARGIN = 100;
+
+    // bounds of the predicted ratio between the times of two iterations
+    constexpr double MIN_BRANCHING_FACTOR = 1.5;
+    constexpr double MAX_BRANCHING_FACTOR = 6.0;
+
+    /**
+     * Decide how long a search lasts. With a clock, the search stops after an
+     * iteration past the soft limit, adjusted with the stability of the best
+     * move and the score, and it doesn't start an iteration that wouldn't end
+     * before the hard limit. The hard limit is enforced inside the search.
+     * Move time searches stop at the given time, other searches don't have a
+     * time limit. While pondering the limits don't apply. After the ponder
+     * hit the time pondered counts for the soft limit, since the search is
+     * that much further, but the hard limit follows the clock, which only
+     * started at the hit.
+     */
+    class TimeManager
+    {
+    private:
+        bool limited;
+        bool adaptive;
+        std::atomic<bool> pondering;
+        std::atomic<std::chrono::steady_clock::time_point> startTime;
+        std::atomic<std::chrono::steady_clock::time_point> clockStartTime;
+        std::atomic<uint64_t> optimumMs;
+        uint64_t softLimitMs;
+        uint64_t hardLimitMs;
+
+        Move lastBestMove;
+        Eval lastScore;
+        int stableIterations;
+        std::chrono::steady_clock::time_point lastIterationEnd;
+        uint64_t lastIterationMs;
+
+    public:
+        TimeManager();
 
-    bool shouldStop(ThinkInfo *info, Depth depth, uint64_t nodes,
-                    std::chrono::_V2::steady_clock::time_point endTime);
+        void clear();
+        void start(const ThinkInfo &info, Color side);
+        void setPondering(bool pondering);
+        bool ponderHit();
+        bool isPondering() const;
+        bool isHardLimitReached() const;
+        bool shouldStopAfterIteration(Move bestMove, Eval score);
+        uint64_t getSoftLimitMs() const;
+        uint64_t getHardLimitMs() const;
+    };
 }
 
 #endif
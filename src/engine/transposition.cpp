@@ -1,51 +1,171 @@
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <thread>
+#include <vector>
 #include "transposition.hpp"
+#include "memory.hpp"
 
 namespace engine
 {
-    TranspositionTable::TranspositionTable()
+    TranspositionTable::TranspositionTable(size_t megabytes)
+        : buckets{NULL}, bucketCount{0}, generation{0}
     {
-        entries = new TTEntry[TT_SIZE];
-        clear();
+        resize(megabytes);
     }
 
     TranspositionTable::~TranspositionTable()
     {
-        delete[] entries;
+        freeLarge(buckets);
+    }
+
+    void TranspositionTable::resize(size_t megabytes)
+    {
+        megabytes = std::clamp<size_t>(megabytes, 1, MAX_HASH_MB);
+        size_t newCount = megabytes * 1024 * 1024 / sizeof(TTBucket);
+
+        // allocate first, so that the old table survives a failed allocation
+        TTBucket *newBuckets = static_cast<TTBucket *>(allocLarge(newCount * sizeof(TTBucket)));
+        if (buckets != NULL)
+        {
+            freeLarge(buckets);
+        }
+        buckets = newBuckets;
+        bucketCount = newCount;
+        clear();
+    }
+
+    // Map the key uniformly over any number of buckets with a multiply-shift,
+    // so that the size doesn't have to be a power of two
+    TTBucket &TranspositionTable::getBucket(Key key) const
+    {
+        return buckets[(size_t)(((__uint128_t)key * bucketCount) >> 64)];
+    }
+
+    // bits 0-15 move, 16-31 eval, 32-39 depth + 1, 40-47 type, 48-55 generation
+    uint64_t TranspositionTable::pack(const TTEntry &entry)
+    {
+        return (uint64_t)entry.hashMove.raw() |
+               (uint64_t)(uint16_t)entry.eval << 16 |
+               (uint64_t)(uint8_t)(entry.depth - INVALID_DEPTH) << 32 |
+               (uint64_t)entry.type << 40 |
+               (uint64_t)entry.generation << 48;
+    }
+
+    TTEntry TranspositionTable::unpack(uint64_t data)
+    {
+        TTEntry entry;
+        entry.hashMove = Move(Tile(data & 0x3f), Tile((data >> 6) & 0x3f), MoveFlag((data >> 12) & 0x0f));
+        entry.eval = (Eval)(uint16_t)(data >> 16);
+        entry.depth = (Depth)((uint8_t)(data >> 32) + INVALID_DEPTH);
+        entry.type = (NodeType)(uint8_t)(data >> 40);
+        entry.generation = (uint8_t)(data >> 48);
+        return entry;
     }
 
-    void TranspositionTable::clear()
+    // Zero the table splitting it in one chunk per thread, since a single
+    // thread is limited by its own memory bandwidth on big tables
+    void TranspositionTable::clear(int threads)
     {
-        for (size_t i = 0; i < TT_SIZE; i++)
+        threads = std::max(threads, 1);
+        size_t chunkSize = (bucketCount + threads - 1) / threads;
+        std::vector<std::thread> helpers;
+
+        for (int i = threads - 1; i >= 0; i--)
         {
-            entries[i].depth = INVALID_DEPTH;
+            size_t start = std::min(i * chunkSize, bucketCount);
+            size_t count = std::min(chunkSize, bucketCount - start);
+
+            // an all zero slot decodes to INVALID_DEPTH
+            auto clearChunk = [this, start, count]()
+            { std::memset(static_cast<void *>(buckets + start), 0, count * sizeof(TTBucket)); };
+
+            if (i == 0)
+                clearChunk();
+            else
+                helpers.emplace_back(clearChunk);
         }
-        occupied = 0;
+
+        for (auto &helper : helpers)
+        {
+            helper.join();
+        }
+        generation = 0;
+    }
+
+    void TranspositionTable::newSearch()
+    {
+        generation++;
     }
 
     void TranspositionTable::add(Key key, Depth depth, NodeType type, Move hashMove, Eval eval)
     {
-        size_t index = key % TT_SIZE;
-        if (entries[index].depth == INVALID_DEPTH)
+        TTSlot *slots = getBucket(key).slots;
+        TTSlot *replace = slots;
+        int replaceValue = INT_MAX;
+
+        for (size_t i = 0; i < TT_BUCKET_SIZE; i++)
         {
-            occupied++;
+            uint64_t data = slots[i].data.load(std::memory_order_relaxed);
+            uint64_t keyXorData = slots[i].keyXorData.load(std::memory_order_relaxed);
+            TTEntry other = unpack(data);
+
+            // slots are never emptied, so an empty slot means the key is not in the bucket
+            if (!other.isValid() || (keyXorData ^ data) == key)
+            {
+                if (other.isValid() && !hashMove.isValid())
+                {
+                    hashMove = other.hashMove;
+                }
+                replace = slots + i;
+                break;
+            }
+
+            // replace the shallowest entry, treating old entries as shallower
+            int age = (uint8_t)(generation - other.generation);
+            int value = other.depth - TT_AGE_WEIGHT * age;
+            if (value < replaceValue)
+            {
+                replaceValue = value;
+                replace = slots + i;
+            }
         }
-        entries[index].key = key;
-        entries[index].depth = depth;
-        entries[index].type = type;
-        entries[index].hashMove = hashMove;
-        entries[index].eval = eval;
+
+        uint64_t data = pack({depth, type, hashMove, eval, generation});
+        replace->keyXorData.store(key ^ data, std::memory_order_relaxed);
+        replace->data.store(data, std::memory_order_relaxed);
     }
 
-    TTEntry *TranspositionTable::get(Key key)
+    bool TranspositionTable::get(Key key, TTEntry &entry) const
     {
-        size_t index = key % TT_SIZE;
-        return entries[index].isValid() && entries[index].key == key
-                   ? entries + index
-                   : NULL;
+        const TTSlot *slots = getBucket(key).slots;
+        for (size_t i = 0; i < TT_BUCKET_SIZE; i++)
+        {
+            uint64_t data = slots[i].data.load(std::memory_order_relaxed);
+            uint64_t keyXorData = slots[i].keyXorData.load(std::memory_order_relaxed);
+            if (data != 0 && (keyXorData ^ data) == key)
+            {
+                entry = unpack(data);
+                return true;
+            }
+        }
+        return false;
     }
 
-    float TranspositionTable::getOccupancyRate()
+    // Estimate the occupancy from a sample of the table, since keeping an exact
+    // counter would need synchronization between the search threads
+    float TranspositionTable::getOccupancyRate() const
     {
-        return (float)occupied / (float)TT_SIZE;
+        size_t sampleSize = std::min<size_t>(1000, bucketCount);
+        size_t occupied = 0;
+        for (size_t i = 0; i < sampleSize; i++)
+        {
+            for (const TTSlot &slot : buckets[i].slots)
+            {
+                TTEntry entry = unpack(slot.data.load(std::memory_order_relaxed));
+                occupied += entry.isValid() && entry.generation == generation;
+            }
+        }
+        return (float)occupied / (float)(sampleSize * TT_BUCKET_SIZE);
     }
 }
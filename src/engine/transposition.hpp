@@ -1,6 +1,7 @@
 #ifndef TRANSPOSITION_H
 #define TRANSPOSITION_H
 
+#include <atomic>
 #include "evaluation.hpp"
 #include "zobrist.hpp"
 #include "move.hpp"
@@ -14,16 +15,22 @@ namespace engine
         UPPER_BOUND,
     };
 
-    constexpr size_t TT_SIZE = 1 << 22;
+    constexpr size_t DEFAULT_HASH_MB = 64;
+    constexpr size_t MAX_HASH_MB = 1 << 16;
     constexpr Depth INVALID_DEPTH = -1;
 
+    constexpr size_t TT_BUCKET_SIZE = 4;
+
+    // this is how much an entry from an older search is worth in plies of depth
+    constexpr int TT_AGE_WEIGHT = 8;
+
     struct TTEntry
     {
-        Key key;
         Depth depth;
         NodeType type;
         Move hashMove;
         Eval eval;
+        uint8_t generation;
 
         bool isValid() const
         {
@@ -31,20 +38,62 @@ namespace engine
         }
     };
 
+    /**
+     * An entry is packed in a single 64 bit word, stored next to the zobrist
+     * key xored with that same word. A reader that sees the two words from
+     * different writes gets back a key that doesn't match, so concurrent
+     * accesses without locks never return a torn entry.
+     */
+    struct TTSlot
+    {
+        std::atomic<uint64_t> keyXorData;
+        std::atomic<uint64_t> data;
+    };
+
+    struct alignas(64) TTBucket
+    {
+        TTSlot slots[TT_BUCKET_SIZE];
+    };
+
+    static_assert(sizeof(TTBucket) == 64, "a bucket must fill exactly one cache line");
+
+    // Mate scores are stored as distance from the node instead of from the
+    // root, so that they stay correct when the entry is probed from another root
+    inline Eval scoreToTT(Eval eval, int ply)
+    {
+        return eval >= MATE_THRESHOLD    ? eval + ply
+               : eval <= -MATE_THRESHOLD ? eval - ply
+                                         : eval;
+    }
+
+    inline Eval scoreFromTT(Eval eval, int ply)
+    {
+        return eval >= MATE_THRESHOLD    ? eval - ply
+               : eval <= -MATE_THRESHOLD ? eval + ply
+                                         : eval;
+    }
+
     class TranspositionTable
     {
     private:
-        TTEntry *entries;
-        size_t occupied;
+        TTBucket *buckets;
+        size_t bucketCount;
+        uint8_t generation;
+
+        TTBucket &getBucket(Key key) const;
+        static uint64_t pack(const TTEntry &entry);
+        static TTEntry unpack(uint64_t data);
 
     public:
-        TranspositionTable();
+        TranspositionTable(size_t megabytes = DEFAULT_HASH_MB);
         ~TranspositionTable();
 
-        void clear();
+        void resize(size_t megabytes);
+        void clear(int threads = 1);
+        void newSearch();
         void add(Key key, Depth depth, NodeType type, Move hashMove, Eval eval);
-        TTEntry *get(Key key);
-        float getOccupancyRate();
+        bool get(Key key, TTEntry &entry) const;
+        float getOccupancyRate() const;
     };
 }
 
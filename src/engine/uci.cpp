@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -6,6 +7,8 @@
 #include <chrono>
 #include <cstdint>
 #include <cassert>
+#include <new>
+#include <stdexcept>
 #include "uci.hpp"
 #include "position.hpp"
 #include "perft.hpp"
@@ -13,51 +16,77 @@
 
 namespace engine
 {
-    UCIEngine::UCIEngine() : bot{Bot()}
+    UCIEngine::UCIEngine() : UCIEngine(true, DEFAULT_HASH_MB)
+    {
+    }
+
+    UCIEngine::UCIEngine(bool ownThread, size_t hashMegabytes) : bot{Bot(ownThread, hashMegabytes)}
     {
         bot.setListener(this);
     }
 
     void UCIEngine::loop()
     {
-        std::string command, token;
-
+        std::string command;
         while (true)
         {
             if (!std::getline(std::cin, command))
                 command = "quit";
 
-            std::istringstream iss(command);
-            token.clear();
-            iss >> token;
+            if (!processCommand(command))
+                exit(0);
+        }
+    }
 
-            if (token == "uci")
-                respond("uciok");
+    bool UCIEngine::processCommand(const std::string &command)
+    {
+        std::istringstream iss(command);
+        std::string token;
+        iss >> token;
 
-            else if (token == "isready")
-                respond("readyok");
+        if (token == "uci")
+        {
+            respond("option name Hash type spin default " + std::to_string(DEFAULT_HASH_MB) +
+                    " min 1 max " + std::to_string(MAX_HASH_MB));
+            respond("option name Threads type spin default 1 min 1 max " + std::to_string(MAX_THREADS));
+            respond("option name Ponder type check default false");
+            respond("option name BookFile type string default <empty>");
+            respond("option name BookBestMove type check default false");
+            respond("option name BitbaseFile type string default <empty>");
+            respond("uciok");
+        }
 
-            else if (token == "ucinewgame")
-                bot.startNewGame();
+        else if (token == "isready")
+            respond("readyok");
 
-            else if (token == "position")
-                processPosition(iss);
+        else if (token == "setoption")
+            processSetOption(iss);
 
-            else if (token == "go")
-                processGo(iss);
+        else if (token == "ucinewgame")
+            bot.startNewGame();
 
-            else if (token == "stop")
-                bot.stopThinking();
+        else if (token == "position")
+            processPosition(iss);
 
-            else if (token == "quit")
-            {
-                bot.stopThinking();
-                exit(0);
-            }
+        else if (token == "go")
+            processGo(iss);
 
-            else if (token == "d")
-                printPosition();
+        else if (token == "stop")
+            stopThinking();
+
+        else if (token == "ponderhit")
+            ponderHit();
+
+        else if (token == "quit")
+        {
+            bot.stopThinking();
+            return false;
         }
+
+        else if (token == "d")
+            printPosition();
+
+        return true;
     }
 
     void UCIEngine::respond(std::string message)
@@ -65,6 +94,75 @@ namespace engine
         std::cout << message << std::endl;
     }
 
+    void UCIEngine::processSetOption(std::istringstream &iss)
+    {
+        std::string token, name, value;
+        iss >> token;
+        if (token != "name")
+        {
+            return;
+        }
+
+        while (iss >> token && token != "value")
+        {
+            name += (name.empty() ? "" : " ") + token;
+        }
+        while (iss >> token)
+        {
+            value += (value.empty() ? "" : " ") + token;
+        }
+
+        setOption(name, value);
+    }
+
+    void UCIEngine::setOption(const std::string &name, const std::string &value)
+    {
+        if (name == "Hash")
+        {
+            try
+            {
+                bot.setHashSize(std::stoul(value));
+            }
+            catch (const std::bad_alloc &)
+            {
+                respond("info string not enough memory for a " + value + " MB hash table");
+            }
+            catch (const std::logic_error &)
+            {
+                respond("info string invalid hash size " + value);
+            }
+        }
+        else if (name == "Threads")
+        {
+            try
+            {
+                bot.setThreads(std::stoi(value));
+            }
+            catch (const std::logic_error &)
+            {
+                respond("info string invalid thread count " + value);
+            }
+        }
+        else if (name == "BookFile")
+        {
+            if (!bot.setBookFile(value == "<empty>" ? "" : value))
+            {
+                respond("info string cannot open the book " + value);
+            }
+        }
+        else if (name == "BookBestMove")
+        {
+            bot.setBookBestMove(value == "true");
+        }
+        else if (name == "BitbaseFile")
+        {
+            if (!bot.setBitbaseFile(value == "<empty>" ? "" : value))
+            {
+                respond("info string cannot load the bitbases " + value);
+            }
+        }
+    }
+
     void UCIEngine::processPosition(std::istringstream &iss)
     {
         std::string token, fen;
@@ -101,8 +199,14 @@ namespace engine
 
         if (token == "perft")
         {
+            // go perft <depth> [hash <megabytes>]
             Depth depth = readNextInt(iss);
-            runPerft(depth);
+            size_t hashMegabytes = 0;
+            if (iss >> token && token == "hash")
+            {
+                hashMegabytes = std::clamp(readNextInt(iss), 0, (int)MAX_HASH_MB);
+            }
+            runPerft(depth, hashMegabytes);
         }
         else
         {
@@ -115,10 +219,25 @@ namespace engine
             {
                 info.flags |= F_INFINITE;
             }
-            bot.startThinking(info);
+            startThinking(info);
         }
     }
 
+    void UCIEngine::startThinking(const ThinkInfo &info)
+    {
+        bot.startThinking(info);
+    }
+
+    void UCIEngine::stopThinking()
+    {
+        bot.stopThinking();
+    }
+
+    void UCIEngine::ponderHit()
+    {
+        bot.ponderHit();
+    }
+
     void UCIEngine::readGoParameters(ThinkInfo &info, std::istringstream &iss, std::string &token)
     {
         if (token == "searchmoves")
@@ -128,8 +247,7 @@ namespace engine
         }
         else if (token == "ponder")
         {
-            // not implemented
-            info.flags |= F_INFINITE;
+            info.task = PONDER;
         }
         else if (token == "wtime")
         {
@@ -189,18 +307,31 @@ namespace engine
         return std::stoi(token);
     }
 
-    void UCIEngine::onReceiveInfo(Depth depth, uint64_t nodes, uint64_t timeMs, float ttOccupancy)
+    void UCIEngine::onReceiveInfo(const SearchInfo &info)
     {
-        timeMs = std::max(1ull, timeMs);
-        uint64_t nps = nodes / timeMs * 1000;
-        int hashfull = ttOccupancy * 1000;
-        respond(std::vformat("info depth {} nodes {} nps {} hashfull {} time {} ",
-                             std::make_format_args(depth, nodes, nps, hashfull, timeMs)));
+        uint64_t timeMs = std::max<uint64_t>(1, info.timeMs);
+        uint64_t nps = info.nodes / timeMs * 1000;
+        int hashfull = info.ttOccupancy * 1000;
+
+        std::string score = info.isMate() ? "mate " + std::to_string(info.getMateMoves())
+                                          : "cp " + std::to_string(info.score);
+        if (info.bound == LOWER_BOUND)
+            score += " lowerbound";
+        else if (info.bound == UPPER_BOUND)
+            score += " upperbound";
+
+        std::string pv;
+        for (Move move : info.pv)
+            pv += " " + moveToUci(move);
+
+        respond(std::vformat("info depth {} seldepth {} score {} nodes {} nps {} hashfull {} time {} pv{}",
+                             std::make_format_args(info.depth, info.selDepth, score, info.nodes, nps,
+                                                   hashfull, timeMs, pv)));
     }
 
-    void UCIEngine::onMoveChosen(std::string move)
+    void UCIEngine::onMoveChosen(std::string move, std::string ponderMove)
     {
-        respond("bestmove " + move);
+        respond(ponderMove.empty() ? "bestmove " + move : "bestmove " + move + " ponder " + ponderMove);
     }
 
     void UCIEngine::printPosition()
@@ -208,17 +339,23 @@ namespace engine
         bot.getPosition().print();
     }
 
-    void UCIEngine::runPerft(Depth depth)
+    void UCIEngine::runPerft(Depth depth, size_t hashMegabytes)
     {
-        Position pos = bot.getPosition();
-        auto begin = std::chrono::steady_clock::now();
-        uint64_t nodes = perft(pos, depth);
-        auto end = std::chrono::steady_clock::now();
-        int64_t elapsedTime = getTimeMs(begin, end);
+        PerftResult result = parallelPerft(bot.getPosition(), depth, bot.getThreads(), hashMegabytes);
 
-        std::cout << "\nNodes:\t" << nodes << std::endl;
-        std::cout << "Time:\t" << elapsedTime << " ms" << std::endl;
-        std::cout << "NPS:\t" << (nodes / elapsedTime) << "k" << std::endl
-                  << std::endl;
+        for (const auto &[move, nodes] : result.divide)
+        {
+            respond(moveToUci(move) + ": " + std::to_string(nodes));
+        }
+        respond("\nNodes:\t" + std::to_string(result.nodes));
+        respond("Time:\t" + std::to_string(result.timeMs) + " ms");
+        respond("NPS:\t" + std::to_string(result.nodes / std::max<int64_t>(result.timeMs, 1)) + "k");
+        for (size_t i = 0; i < result.threads.size(); i++)
+        {
+            const PerftThreadInfo &thread = result.threads[i];
+            respond("Thread " + std::to_string(i) + ":\t" + std::to_string(thread.nodes) + " nodes\t" +
+                    std::to_string(thread.nodes / std::max<int64_t>(thread.timeMs, 1)) + "k nps");
+        }
+        respond("");
     }
 }
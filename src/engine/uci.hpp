@@ -11,26 +11,36 @@ namespace engine
 {
     class UCIEngine : public MoveListener
     {
-    private:
+    protected:
         Bot bot;
 
-        void respond(std::string message);
+        UCIEngine(bool ownThread, size_t hashMegabytes);
+
+        virtual void respond(std::string message);
+        virtual void setOption(const std::string &name, const std::string &value);
+        virtual void startThinking(const ThinkInfo &info);
+        virtual void stopThinking();
+        virtual void ponderHit();
 
+    private:
+        void processSetOption(std::istringstream &iss);
         void processPosition(std::istringstream &iss);
         void processGo(std::istringstream &iss);
         void readGoParameters(ThinkInfo &info, std::istringstream &iss, std::string &token);
         int readNextInt(std::istringstream &iss);
         void printPosition();
 
-        void runPerft(Depth depth);
+        void runPerft(Depth depth, size_t hashMegabytes);
 
     public:
         UCIEngine();
+        virtual ~UCIEngine() = default;
 
         void loop();
-        void onReceiveInfo(Depth depth, uint64_t nodes, uint64_t timeMs,
-                           float ttOccupancy) override;
-        void onMoveChosen(std::string move) override;
+        // Return false on quit
+        virtual bool processCommand(const std::string &command);
+        void onReceiveInfo(const SearchInfo &info) override;
+        void onMoveChosen(std::string move, std::string ponderMove) override;
     };
 }
 
@@ -21,12 +21,16 @@ using namespace engine;
 namespace utils
 {
     /**
-     * Function to generate good numbers fot the magic bitboards technique.
+     * Function to generate good numbers for the magic bitboards technique.
      * It reads these numbers from a "magics.txt" file (if some have already
-     * been generate), tries to find better numbers, and then write them
-     * back to the file.
+     * been generated), tries to find numbers that index fewer entries, and
+     * then writes them back to the file. The tables of all the squares are
+     * packed one after the other, so every bit saved on a square halves its
+     * slice. Two blockers may share an entry when they give the same attacks.
+     *
+     * @param attempts magic numbers tried for every square and piece
      */
-    void generateMagics()
+    void generateMagics(int attempts = 10000000)
     {
         Bitboard rookMagics[64];
         unsigned rookShifts[64];
@@ -39,22 +43,22 @@ namespace utils
         {
             for (int i = 0; i < 64; i++)
             {
-                std::getline(inputFile, number, ',');
+                std::getline(inputFile >> std::ws, number, ',');
                 rookMagics[i] = std::stoull(number);
             }
             for (int i = 0; i < 64; i++)
             {
-                std::getline(inputFile, number, ',');
+                std::getline(inputFile >> std::ws, number, ',');
                 rookShifts[i] = std::stoi(number);
             }
             for (int i = 0; i < 64; i++)
             {
-                std::getline(inputFile, number, ',');
+                std::getline(inputFile >> std::ws, number, ',');
                 bishopMagics[i] = std::stoull(number);
             }
             for (int i = 0; i < 64; i++)
             {
-                std::getline(inputFile, number, ',');
+                std::getline(inputFile >> std::ws, number, ',');
                 bishopShifts[i] = std::stoi(number);
             }
             inputFile.close();
@@ -70,87 +74,82 @@ namespace utils
             }
         }
 
+        // magics with few bits set spread the blockers best
         std::random_device rnd;
         std::mt19937_64 gen(rnd());
-        std::uniform_int_distribution<uint64_t> dist(std::llround(std::pow(2, 61)), std::llround(std::pow(2, 62)));
+        auto sparseRandom = [&gen]()
+        { return gen() & gen() & gen(); };
 
-        std::unordered_set<Bitboard> keys;
-        std::unordered_set<Bitboard> newKeys;
         std::vector<Bitboard> blockers;
+        std::vector<Bitboard> attacks;
+        // the entries of an attempt are those stamped with its number,
+        // so that the table is not cleared between attempts
+        std::vector<Bitboard> table;
+        std::vector<int> stamps;
 
         for (Tile tile = A1; tile <= H8; ++tile)
         {
-            std::cout << "Generating magics for " << toString(tile) << std::endl;
-
             for (PieceType pt : {ROOK, BISHOP})
             {
+                Bitboard mask = pseudoAttacks[pt][tile];
                 blockers.clear();
-                bitboard::generateBlockers(pseudoAttacks[pt][tile], blockers);
+                attacks.clear();
+                bitboard::generateBlockers(mask, blockers);
+                for (Bitboard blocker : blockers)
+                {
+                    attacks.push_back(bitboard::getSlidingAttacks(tile, blocker, pt == ROOK ? ORTHOGONAL : DIAGONAL));
+                }
+
                 Bitboard *magics = pt == ROOK ? rookMagics : bishopMagics;
                 unsigned *shifts = pt == ROOK ? rookShifts : bishopShifts;
-
-                for (int i = 0; i < 10000; i++)
+                // one bit per blocker square is always enough, then one less is tried
+                unsigned shift = std::max(shifts[tile], 64 - (unsigned)__builtin_popcountll(mask)) + 1;
+                if (shifts[tile] < 64 - (unsigned)__builtin_popcountll(mask))
+                    shift--;
+
+                table.assign(size_t(1) << (64 - shift), 0);
+                stamps.assign(table.size(), 0);
+                for (int attempt = 1; attempt <= attempts; attempt++)
                 {
-                    Bitboard magic = dist(gen);
-                    keys.clear();
+                    Bitboard magic = sparseRandom();
+                    // the high bits of the key must depend on most of the mask
+                    if (__builtin_popcountll((mask * magic) >> 56) < 6)
+                        continue;
 
-                    bool betterMagic = true;
-                    for (const auto &blocker : blockers)
+                    bool found = true;
+                    for (size_t i = 0; i < blockers.size() && found; i++)
                     {
-                        Bitboard key = (blocker * magic) >> shifts[tile];
-                        if (keys.contains(key))
+                        size_t key = (blockers[i] * magic) >> shift;
+                        if (stamps[key] != attempt)
                         {
-                            betterMagic = false;
-                            break;
+                            stamps[key] = attempt;
+                            table[key] = attacks[i];
                         }
-                        keys.insert(key);
-                    }
-
-                    if (betterMagic)
-                    {
-                        unsigned shift = shifts[tile];
-                        while (true)
+                        else if (table[key] != attacks[i])
                         {
-                            newKeys.clear();
-                            for (const auto &key : keys)
-                            {
-                                newKeys.insert(key >> 1);
-                            }
-                            if (newKeys.size() != keys.size())
-                            {
-                                break;
-                            }
-                            shift++;
-                            keys.clear();
-                            for (const auto &newKey : newKeys)
-                            {
-                                keys.insert(newKey);
-                            }
+                            found = false;
                         }
+                    }
 
+                    if (found)
+                    {
                         magics[tile] = magic;
                         shifts[tile] = shift;
+                        break;
                     }
                 }
+
+                std::cout << (pt == ROOK ? "Rook " : "Bishop ") << toString(tile) << ": "
+                          << 64 - shifts[tile] << " bits" << std::endl;
             }
         }
 
-        std::cout
-            << "Best rook bits count: "
-            << (64 - *std::max_element(rookShifts, rookShifts + 64))
-            << std::endl;
-        std::cout
-            << "Worst rook bits count: "
-            << (64 - *std::min_element(rookShifts, rookShifts + 64))
-            << std::endl;
-        std::cout
-            << "Best bishop bits count: "
-            << (64 - *std::max_element(bishopShifts, bishopShifts + 64))
-            << std::endl;
-        std::cout
-            << "Worst bishop bits count: "
-            << (64 - *std::min_element(bishopShifts, bishopShifts + 64))
-            << std::endl;
+        size_t entries = 0;
+        for (int i = 0; i < 64; i++)
+        {
+            entries += (size_t(1) << (64 - rookShifts[i])) + (size_t(1) << (64 - bishopShifts[i]));
+        }
+        std::cout << "Packed tables: " << entries * sizeof(Bitboard) / 1024 << " KB" << std::endl;
 
         std::ofstream outputFile("magics.txt");
         for (int i = 0; i < 64; i++)
@@ -10,27 +10,27 @@ namespace engine
 
     void zobrist::init()
     {
-        std::random_device rnd;
-        std::mt19937_64 gen(rnd());
-        std::uniform_int_distribution<uint64_t> dist(
-            std::llround(std::pow(2, 61)),
-            std::llround(std::pow(2, 62)));
+        // the keys are the same on every run and on every platform, so that a
+        // search is reproducible. The raw generator output is used, since the
+        // distributions are implementation defined. The keys use all 64 bits,
+        // the hash tables are indexed by the high bits
+        std::mt19937_64 gen(ZOBRIST_SEED);
 
         for (int i = 0; i < 15; i++)
         {
             for (int j = 0; j < 64; j++)
             {
-                pieceTileZ[i][j] = dist(gen);
+                pieceTileZ[i][j] = gen();
             }
         }
         for (int i = 0; i < 16; i++)
         {
-            castlingZ[i] = dist(gen);
+            castlingZ[i] = gen();
         }
         for (int i = 0; i < 8; i++)
         {
-            enPassantFileZ[i] = dist(gen);
+            enPassantFileZ[i] = gen();
         }
-        turnZ = dist(gen);
+        turnZ = gen();
     }
 }
@@ -6,6 +6,8 @@
 
 namespace engine
 {
+    constexpr uint64_t ZOBRIST_SEED = 0x2545f4914f6cdd1dULL;
+
     extern Key pieceTileZ[15][64];
     extern Key castlingZ[16];
     extern Key enPassantFileZ[8];
@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "engine/bot.hpp"
+#include "engine/search.hpp"
+#include "engine/listeners.hpp"
+#include "engine/position.hpp"
+#include "engine/zobrist.hpp"
+#include "engine/bitboard.hpp"
+#include "engine/misc.hpp"
+
+constexpr engine::Depth DEFAULT_EPD_DEPTH = 8;
+constexpr size_t DEFAULT_EPD_HASH_MB = 16;
+
+struct EpdEntry
+{
+    std::string file;
+    std::string id;
+    std::string fen;
+    std::vector<std::string> bestMoves;
+    std::vector<std::string> avoidMoves;
+};
+
+struct EpdResult
+{
+    std::string move;
+    bool solved;
+    int depth;
+    uint64_t nodes;
+    uint64_t timeMs;
+    // time and nodes of the first iteration from which the best move
+    // stayed a solution, -1 when the position is not solved
+    int64_t solveTimeMs;
+    int64_t solveNodes;
+    double ttHitRate;
+};
+
+struct RunnerOptions
+{
+    std::vector<std::string> files;
+    int workers = std::max<int>(std::thread::hardware_concurrency(), 1);
+    engine::ThinkInfo limits;
+    size_t hashMegabytes = DEFAULT_EPD_HASH_MB;
+    bool csv = false;
+    std::string output;
+};
+
+// SAN without the decorations that EPD files write in different ways
+std::string normalizeSan(const std::string &san)
+{
+    std::string normalized;
+    for (char c : san)
+    {
+        if (c == '0')
+            normalized += 'O';
+        else if (std::string("+#!?x=").find(c) == std::string::npos)
+            normalized += c;
+    }
+    return normalized;
+}
+
+bool isSolution(const EpdEntry &entry, engine::Position &pos, engine::Move move)
+{
+    if (!move.isValid())
+        return false;
+
+    std::string san = normalizeSan(engine::moveToSan(pos, move));
+    auto matches = [&san](const std::string &other)
+    { return normalizeSan(other) == san; };
+
+    if (!entry.bestMoves.empty())
+        return std::any_of(entry.bestMoves.begin(), entry.bestMoves.end(), matches);
+    return std::none_of(entry.avoidMoves.begin(), entry.avoidMoves.end(), matches);
+}
+
+// Follow the best move of every iteration, to know since when the search has the solution
+class SolutionListener : public engine::SearchListener
+{
+public:
+    const EpdEntry *entry = NULL;
+    engine::Position *pos = NULL;
+    engine::Move bestMove;
+    int depth = 0;
+    int64_t solveTimeMs = -1;
+    int64_t solveNodes = -1;
+
+    void reset(const EpdEntry *entry, engine::Position *pos)
+    {
+        this->entry = entry;
+        this->pos = pos;
+        bestMove = engine::Move();
+        depth = 0;
+        solveTimeMs = solveNodes = -1;
+    }
+
+    void onSearchInfo(const engine::SearchInfo &info) override
+    {
+        // after a fail low the search keeps the previous move
+        if (info.pv.empty() || info.bound == engine::UPPER_BOUND)
+            return;
+
+        if (info.bound == engine::EXACT)
+            depth = info.depth;
+
+        if (!isSolution(*entry, *pos, info.pv[0]))
+            solveTimeMs = solveNodes = -1;
+        else if (solveTimeMs < 0)
+        {
+            solveTimeMs = info.timeMs;
+            solveNodes = info.nodes;
+        }
+    }
+
+    void onSearchComplete(engine::Move move, engine::Move) override
+    {
+        bestMove = move;
+    }
+};
+
+// The first four fields are the position, then come the operations, each ending with ';'
+bool parseEpdLine(const std::string &line, EpdEntry &entry)
+{
+    std::istringstream iss(line);
+    std::string field;
+    entry.fen.clear();
+    for (int i = 0; i < 4; i++)
+    {
+        if (!(iss >> field))
+            return false;
+        entry.fen += field + " ";
+    }
+    entry.fen += "0 1";
+
+    std::string operations;
+    std::getline(iss, operations);
+    std::istringstream opStream(operations);
+    std::string operation;
+    while (std::getline(opStream, operation, ';'))
+    {
+        std::istringstream opIss(operation);
+        std::string opcode, operand;
+        if (!(opIss >> opcode))
+            continue;
+
+        while (opIss >> operand)
+        {
+            if (opcode == "bm")
+                entry.bestMoves.push_back(operand);
+            else if (opcode == "am")
+                entry.avoidMoves.push_back(operand);
+            else if (opcode == "id")
+                entry.id += (entry.id.empty() ? "" : " ") + operand;
+        }
+    }
+    entry.id.erase(std::remove(entry.id.begin(), entry.id.end(), '"'), entry.id.end());
+    return !entry.bestMoves.empty() || !entry.avoidMoves.empty();
+}
+
+std::vector<EpdEntry> readEpdFile(const std::string &fileName)
+{
+    std::vector<EpdEntry> entries;
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        std::cerr << "Cannot open " << fileName << std::endl;
+        return entries;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        EpdEntry entry;
+        entry.file = fileName;
+        if (parseEpdLine(line, entry))
+        {
+            if (entry.id.empty())
+                entry.id = std::to_string(lineNumber);
+            entries.push_back(entry);
+        }
+    }
+    return entries;
+}
+
+std::string escapeJson(const std::string &text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+std::string join(const std::vector<std::string> &moves)
+{
+    std::string joined;
+    for (const auto &move : moves)
+        joined += (joined.empty() ? "" : " ") + move;
+    return joined;
+}
+
+void writeResults(std::ostream &out, const RunnerOptions &options,
+                  const std::vector<EpdEntry> &entries, const std::vector<EpdResult> &results)
+{
+    if (options.csv)
+    {
+        out << "file,id,fen,bm,am,move,solved,depth,nodes,nps,time_ms,solve_time_ms,solve_nodes,tt_hit_rate\n";
+    }
+    else
+    {
+        out << "[\n";
+    }
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const EpdEntry &entry = entries[i];
+        const EpdResult &result = results[i];
+        uint64_t nps = result.nodes * 1000 / std::max<uint64_t>(result.timeMs, 1);
+
+        if (options.csv)
+        {
+            out << entry.file << "," << entry.id << "," << entry.fen << "," << join(entry.bestMoves) << ","
+                << join(entry.avoidMoves) << "," << result.move << "," << result.solved << ","
+                << result.depth << "," << result.nodes << "," << nps << "," << result.timeMs << ","
+                << result.solveTimeMs << "," << result.solveNodes << "," << result.ttHitRate << "\n";
+        }
+        else
+        {
+            out << "  {\"file\": \"" << escapeJson(entry.file) << "\", \"id\": \"" << escapeJson(entry.id)
+                << "\", \"fen\": \"" << entry.fen << "\", \"bm\": \"" << join(entry.bestMoves)
+                << "\", \"am\": \"" << join(entry.avoidMoves) << "\", \"move\": \"" << result.move
+                << "\", \"solved\": " << (result.solved ? "true" : "false") << ", \"depth\": " << result.depth
+                << ", \"nodes\": " << result.nodes << ", \"nps\": " << nps << ", \"time_ms\": " << result.timeMs
+                << ", \"solve_time_ms\": " << result.solveTimeMs << ", \"solve_nodes\": " << result.solveNodes
+                << ", \"tt_hit_rate\": " << result.ttHitRate << "}" << (i + 1 < entries.size() ? "," : "") << "\n";
+        }
+    }
+
+    if (!options.csv)
+    {
+        out << "]\n";
+    }
+}
+
+void printUsage()
+{
+    std::cerr << "Usage: epdrunner [options] <file.epd>...\n"
+                 "  -j <workers>   positions searched at the same time, one search thread each\n"
+                 "  -d <depth>     depth limit of every position\n"
+                 "  -t <ms>        time limit of every position\n"
+                 "  -n <nodes>     node limit of every position\n"
+                 "  -H <MB>        hash of every worker (default " << DEFAULT_EPD_HASH_MB << ")\n"
+                 "  -f json|csv    output format (default json)\n"
+                 "  -o <file>      output file (default standard output)\n"
+                 "Without limits every position is searched to depth " << (int)DEFAULT_EPD_DEPTH << ".\n";
+}
+
+bool parseOptions(int argc, char *argv[], RunnerOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.size() == 2 && arg[0] == '-' && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            switch (arg[1])
+            {
+            case 'j':
+                options.workers = std::max(std::atoi(value.c_str()), 1);
+                break;
+            case 'd':
+                options.limits.flags |= engine::F_DEPTH;
+                options.limits.depth = std::atoi(value.c_str());
+                break;
+            case 't':
+                options.limits.flags |= engine::F_MOVETIME;
+                options.limits.moveTime = std::atoi(value.c_str());
+                break;
+            case 'n':
+                options.limits.flags |= engine::F_NODES;
+                options.limits.nodes = std::atoi(value.c_str());
+                break;
+            case 'H':
+                options.hashMegabytes = std::clamp<size_t>(std::atoi(value.c_str()), 1, engine::MAX_HASH_MB);
+                break;
+            case 'f':
+                options.csv = value == "csv";
+                break;
+            case 'o':
+                options.output = value;
+                break;
+            default:
+                return false;
+            }
+        }
+        else if (arg[0] != '-')
+        {
+            options.files.push_back(arg);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (options.limits.flags == engine::NO_THINK_FLAG)
+    {
+        options.limits.flags |= engine::F_DEPTH;
+        options.limits.depth = DEFAULT_EPD_DEPTH;
+    }
+    return !options.files.empty();
+}
+
+int main(int argc, char *argv[])
+{
+    RunnerOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::vector<EpdEntry> entries;
+    for (const auto &fileName : options.files)
+    {
+        std::vector<EpdEntry> fileEntries = readEpdFile(fileName);
+        entries.insert(entries.end(), fileEntries.begin(), fileEntries.end());
+    }
+
+    std::vector<EpdResult> results(entries.size());
+    std::atomic<size_t> nextEntry{0};
+    std::atomic<int> solved{0};
+    std::mutex printMutex;
+    auto begin = std::chrono::steady_clock::now();
+
+    // every worker has its own search, with its own hash and history
+    auto work = [&]()
+    {
+        engine::SearchManager SM;
+        SM.setHashSize(options.hashMegabytes);
+        SolutionListener listener;
+        SM.setListener(&listener);
+
+        size_t i;
+        while ((i = nextEntry.fetch_add(1)) < entries.size())
+        {
+            const EpdEntry &entry = entries[i];
+            engine::Position pos(entry.fen);
+            engine::ThinkInfo limits = options.limits;
+            engine::SearchDiagnostic sc;
+
+            SM.clear();
+            listener.reset(&entry, &pos);
+            SM.resetStop();
+            SM.startSearch(pos, &limits, &sc);
+
+            EpdResult &result = results[i];
+            result.move = engine::moveToSan(pos, listener.bestMove);
+            result.solved = isSolution(entry, pos, listener.bestMove);
+            result.depth = listener.depth;
+            result.nodes = sc.nodes;
+            result.timeMs = sc.timeMs;
+            result.solveTimeMs = result.solved ? listener.solveTimeMs : -1;
+            result.solveNodes = result.solved ? listener.solveNodes : -1;
+            result.ttHitRate = sc.ttAccesses > 0 ? (double)sc.ttHits / sc.ttAccesses : 0;
+            solved += result.solved;
+
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cerr << entry.id << "\tbm: " << join(entry.bestMoves) << "\tmove: " << result.move
+                      << "\t" << (result.solved ? "X" : " ") << std::endl;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.workers; i++)
+    {
+        workers.emplace_back(work);
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    int64_t wallTimeMs = engine::getTimeMs(begin, std::chrono::steady_clock::now());
+
+    if (options.output.empty())
+    {
+        writeResults(std::cout, options, entries, results);
+    }
+    else
+    {
+        std::ofstream out(options.output);
+        writeResults(out, options, entries, results);
+    }
+
+    uint64_t nodes = 0;
+    uint64_t searchTimeMs = 0;
+    for (const auto &result : results)
+    {
+        nodes += result.nodes;
+        searchTimeMs += result.timeMs;
+    }
+    std::cerr << "\nSolved:\t\t" << solved << "/" << entries.size() << std::endl;
+    std::cerr << "Nodes:\t\t" << nodes << std::endl;
+    std::cerr << "Search time:\t" << searchTimeMs << " ms" << std::endl;
+    std::cerr << "Wall time:\t" << wallTimeMs << " ms with " << options.workers << " workers" << std::endl;
+    std::cerr << "NPS:\t\t" << nodes * 1000 / std::max<uint64_t>(searchTimeMs, 1) << std::endl;
+
+    return 0;
+}
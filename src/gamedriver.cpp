@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "engine/server.hpp"
+#include "engine/bitbase.hpp"
+#include "engine/bot.hpp"
+#include "engine/generator.hpp"
+#include "engine/position.hpp"
+#include "engine/zobrist.hpp"
+#include "engine/bitboard.hpp"
+#include "engine/misc.hpp"
+
+struct DriverOptions
+{
+    int clients = 8;
+    int games = 0;
+    int threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    size_t hashMegabytes = engine::DEFAULT_SERVER_HASH_MB;
+    int moveTime = 100;
+    int maxPlies = 60;
+    int openingPlies = 4;
+    unsigned seed = 1;
+};
+
+// A stand-in for a game client: it sends a go command and waits for the bestmove
+struct Client
+{
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::string bestMove;
+    bool waiting = false;
+    std::vector<double> latenciesMs;
+    int moves = 0;
+};
+
+std::vector<Client> clients;
+
+// responses are "<client>-<game> <uci response>"
+void onServerOutput(const std::string &line)
+{
+    size_t space = line.find(' ');
+    if (space == std::string::npos || line.compare(space + 1, 9, "bestmove ") != 0)
+        return;
+
+    Client &client = clients[std::stoi(line.substr(0, line.find('-')))];
+    std::lock_guard<std::mutex> lock(client.mutex);
+    size_t moveStart = space + 10;
+    client.bestMove = line.substr(moveStart, line.find(' ', moveStart) - moveStart);
+    client.waiting = false;
+    client.condition.notify_one();
+}
+
+engine::Move findMove(engine::Position &pos, const std::string &uci)
+{
+    engine::MoveList moveList;
+    engine::generateMoves<engine::ALL>(pos, moveList);
+    for (size_t i = 0; i < moveList.size; i++)
+        if (engine::moveToUci(moveList.moves[i]) == uci)
+            return moveList.moves[i];
+    return engine::Move();
+}
+
+// Play games from random openings until they end or reach the ply limit
+void playGames(engine::GameServer &server, const DriverOptions &options, int clientIndex,
+               std::atomic<int> &nextGame)
+{
+    Client &client = clients[clientIndex];
+    int game;
+    while ((game = nextGame.fetch_add(1)) < options.games)
+    {
+        std::string id = std::to_string(clientIndex) + "-" + std::to_string(game);
+        std::mt19937 random(options.seed + game);
+        engine::Position pos(engine::START_FEN);
+        std::string moves;
+
+        server.processLine(id + " ucinewgame");
+        for (int ply = 0; ply < options.maxPlies && pos.getHalfMove() < 100; ply++)
+        {
+            engine::MoveList moveList;
+            engine::generateMoves<engine::ALL>(pos, moveList);
+            if (moveList.size == 0)
+                break;
+
+            std::string move;
+            if (ply < options.openingPlies)
+            {
+                move = engine::moveToUci(moveList.moves[random() % moveList.size]);
+            }
+            else
+            {
+                server.processLine(id + " position startpos moves" + moves);
+                auto begin = std::chrono::steady_clock::now();
+                {
+                    std::unique_lock<std::mutex> lock(client.mutex);
+                    client.waiting = true;
+                }
+                server.processLine(id + " go movetime " + std::to_string(options.moveTime));
+
+                std::unique_lock<std::mutex> lock(client.mutex);
+                client.condition.wait(lock, [&client]
+                                      { return !client.waiting; });
+                client.latenciesMs.push_back(
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+                client.moves++;
+                move = client.bestMove;
+            }
+
+            engine::Move played = findMove(pos, move);
+            if (!played.isValid())
+                break;
+            pos.makeTurn(played);
+            moves += " " + move;
+        }
+        server.processLine(id + " quit");
+    }
+}
+
+// the peak resident memory of the process, 0 when unknown
+size_t getPeakMemoryKb()
+{
+#if defined(__linux__)
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.rfind("VmHWM:", 0) == 0)
+            return std::atol(line.c_str() + 6);
+    }
+#endif
+    return 0;
+}
+
+void printUsage()
+{
+    std::cerr << "Usage: gamedriver [options]\n"
+                 "  -c <clients>   games played at the same time (default 8)\n"
+                 "  -g <games>     games in total (default two per client)\n"
+                 "  -j <threads>   search workers of the server\n"
+                 "  -H <MB>        hash budget of the server (default " << engine::DEFAULT_SERVER_HASH_MB << ")\n"
+                 "  -t <ms>        time of every move (default 100)\n"
+                 "  -p <plies>     plies of every game (default 60)\n"
+                 "  -r <plies>     random plies at the start of every game (default 4)\n"
+                 "  -s <seed>      seed of the random openings\n";
+}
+
+bool parseOptions(int argc, char *argv[], DriverOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.size() != 2 || arg[0] != '-' || i + 1 == argc)
+            return false;
+
+        int value = std::atoi(argv[++i]);
+        switch (arg[1])
+        {
+        case 'c':
+            options.clients = std::max(value, 1);
+            break;
+        case 'g':
+            options.games = std::max(value, 1);
+            break;
+        case 'j':
+            options.threads = std::max(value, 1);
+            break;
+        case 'H':
+            options.hashMegabytes = std::clamp<size_t>(value, 1, engine::MAX_HASH_MB);
+            break;
+        case 't':
+            options.moveTime = std::max(value, 1);
+            break;
+        case 'p':
+            options.maxPlies = std::max(value, 1);
+            break;
+        case 'r':
+            options.openingPlies = std::max(value, 0);
+            break;
+        case 's':
+            options.seed = value;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (options.games == 0)
+        options.games = 2 * options.clients;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    DriverOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    engine::bitboard::init();
+    engine::zobrist::init();
+    engine::bitbase::generate(options.threads, false);
+
+    clients = std::vector<Client>(options.clients);
+    std::atomic<int> nextGame{0};
+    auto begin = std::chrono::steady_clock::now();
+    {
+        engine::GameServer server(options.threads, options.clients, options.hashMegabytes, onServerOutput);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < options.clients; i++)
+        {
+            threads.emplace_back(playGames, std::ref(server), std::cref(options), i, std::ref(nextGame));
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+    int64_t wallTimeMs = engine::getTimeMs(begin, std::chrono::steady_clock::now());
+
+    std::vector<double> latencies;
+    for (const auto &client : clients)
+    {
+        latencies.insert(latencies.end(), client.latenciesMs.begin(), client.latenciesMs.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p)
+    { return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))]; };
+
+    double wallTimeS = std::max<int64_t>(wallTimeMs, 1) / 1000.0;
+    std::cout << "Games:\t\t" << options.games << " (" << options.clients << " at a time, "
+              << options.threads << " workers, " << options.hashMegabytes / options.clients
+              << " MB hash each)" << std::endl;
+    std::cout << "Moves:\t\t" << latencies.size() << " searched, " << options.moveTime << " ms each" << std::endl;
+    std::cout << "Wall time:\t" << wallTimeMs << " ms" << std::endl;
+    std::cout << "Throughput:\t" << latencies.size() / wallTimeS << " moves/s, "
+              << options.games * 60 / wallTimeS << " games/min" << std::endl;
+    std::cout << "Move latency:\tp50 " << percentile(0.5) << " ms, p90 " << percentile(0.9) << " ms, p99 "
+              << percentile(0.99) << " ms, max " << percentile(1.0) << " ms" << std::endl;
+    std::cout << "Peak memory:\t" << getPeakMemoryKb() / 1024 << " MB" << std::endl;
+    return 0;
+}
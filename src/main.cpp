@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -5,16 +6,71 @@
 #include <chrono>
 #include <cstdint>
 #include <cassert>
+#include <cstdlib>
+#include <thread>
 #include <time.h>
 #include "engine/uci.hpp"
+#include "engine/bench.hpp"
+#include "engine/bitbase.hpp"
+#include "engine/server.hpp"
 #include "engine/zobrist.hpp"
 #include "engine/bitboard.hpp"
 
-int main()
+int main(int argc, char *argv[])
 {
     srand(time(0));
     engine::bitboard::init();
     engine::zobrist::init();
+    int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // rooster bitbases <file> [threads]
+    if (argc > 2 && std::string(argv[1]) == "bitbases")
+    {
+        int threads = argc > 3 ? std::atoi(argv[3]) : hardwareThreads;
+        auto begin = std::chrono::steady_clock::now();
+        engine::bitbase::generate(threads);
+        auto end = std::chrono::steady_clock::now();
+        if (!engine::bitbase::save(argv[2]))
+        {
+            std::cerr << "cannot write " << argv[2] << std::endl;
+            return 1;
+        }
+        size_t bytes = 0;
+        for (int id = 0; id < engine::BITBASE_COUNT; id++)
+        {
+            bytes += engine::bitbase::getTableBytes(engine::BitbaseId(id));
+        }
+        std::cout << "generated in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
+                  << " ms on " << threads << " threads, " << bytes << " bytes of tables" << std::endl;
+        return 0;
+    }
+
+    // the small tables take a fraction of a second, KBNK is loaded from a file
+    engine::bitbase::generate(hardwareThreads, false);
+
+    // rooster bench [depth] [threads] [hash]
+    if (argc > 1 && std::string(argv[1]) == "bench")
+    {
+        engine::Depth depth = argc > 2 ? std::clamp(std::atoi(argv[2]), 1, (int)engine::MAX_DEPTH)
+                                       : engine::DEFAULT_BENCH_DEPTH;
+        int threads = argc > 3 ? std::atoi(argv[3]) : 1;
+        size_t hashMegabytes = argc > 4 ? std::clamp<size_t>(std::atoi(argv[4]), 1, engine::MAX_HASH_MB)
+                                        : engine::DEFAULT_BENCH_HASH_MB;
+        engine::runBench(depth, threads, hashMegabytes);
+        return 0;
+    }
+
+    // rooster server [games] [threads] [hash]
+    if (argc > 1 && std::string(argv[1]) == "server")
+    {
+        size_t games = argc > 2 ? std::max(std::atoi(argv[2]), 1) : engine::DEFAULT_SERVER_SESSIONS;
+        int threads = argc > 3 ? std::atoi(argv[3]) : hardwareThreads;
+        size_t hashMegabytes = argc > 4 ? std::clamp<size_t>(std::atoi(argv[4]), 1, engine::MAX_HASH_MB)
+                                        : engine::DEFAULT_SERVER_HASH_MB;
+        engine::GameServer server(threads, games, hashMegabytes);
+        server.loop();
+        return 0;
+    }
 
     engine::UCIEngine eng;
     eng.loop();
@@ -4,11 +4,27 @@
 #include <vector>
 #include <tuple>
 #include <numeric>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <filesystem>
 #include "bot.hpp"
+#include "bitbase.hpp"
+#include "book.hpp"
+#include "server.hpp"
+#include "generator.hpp"
 #include "perft.hpp"
+#include "movepicker.hpp"
+#include "pawns.hpp"
+#include "evaluation.hpp"
+#include "time.hpp"
 #include "position.hpp"
 #include "zobrist.hpp"
 #include "bitboard.hpp"
+#include "misc.hpp"
 
 uint64_t average(std::vector<uint64_t> const &v)
 {
@@ -17,6 +33,28 @@ uint64_t average(std::vector<uint64_t> const &v)
     return std::reduce(v.begin(), v.end()) / v.size();
 }
 
+// Record the info of the last completed iteration of a search
+class InfoListener : public engine::SearchListener
+{
+public:
+    engine::SearchInfo info = {};
+    engine::Move bestMove;
+    engine::Move ponderMove;
+    std::atomic<bool> done = false;
+
+    void onSearchInfo(const engine::SearchInfo &info) override
+    {
+        if (info.bound == engine::EXACT)
+            this->info = info;
+    }
+    void onSearchComplete(engine::Move move, engine::Move ponderMove) override
+    {
+        bestMove = move;
+        this->ponderMove = ponderMove;
+        done = true;
+    }
+};
+
 TEST_CASE("PerftTest", "[engine]")
 {
     engine::bitboard::init();
@@ -62,8 +100,17 @@ TEST_CASE("PerftTest", "[engine]")
         std::tie(fen, depth, expected) = testCase;
 
         engine::Position pos(fen);
-        uint64_t actual = engine::perft(pos, depth, false);
+        uint64_t actual = engine::perft(pos, depth);
         REQUIRE(actual == expected);
+
+        engine::PerftResult result = engine::parallelPerft(pos, depth, 3, 16);
+        uint64_t divideSum = 0;
+        for (const auto &[move, nodes] : result.divide)
+        {
+            divideSum += nodes;
+        }
+        REQUIRE(result.nodes == expected);
+        REQUIRE(divideSum == expected);
     }
 }
 
@@ -108,8 +155,15 @@ TEST_CASE("MoveTest", "[engine]")
     std::vector<uint64_t> qNodes;
     std::vector<uint64_t> timesMs;
     std::vector<uint64_t> cutOffs;
+    std::vector<uint64_t> failLows;
+    std::vector<uint64_t> failHighs;
+    std::vector<uint64_t> moveCutOffs;
+    std::vector<uint64_t> firstMoveCutOffs;
+    std::vector<uint64_t> quietGenerations;
     std::vector<uint64_t> ttAccesses;
     std::vector<uint64_t> ttHits;
+    std::vector<uint64_t> pawnAccesses;
+    std::vector<uint64_t> pawnHits;
 
     std::string line;
     std::string fen;
@@ -145,8 +199,15 @@ TEST_CASE("MoveTest", "[engine]")
             qNodes.push_back(sc.qNodes);
             timesMs.push_back(sc.timeMs);
             cutOffs.push_back(sc.cutOffs);
+            failLows.push_back(sc.failLows);
+            failHighs.push_back(sc.failHighs);
+            moveCutOffs.push_back(sc.moveCutOffs);
+            firstMoveCutOffs.push_back(sc.firstMoveCutOffs);
+            quietGenerations.push_back(sc.quietGenerations);
             ttAccesses.push_back(sc.ttAccesses);
             ttHits.push_back(sc.ttHits);
+            pawnAccesses.push_back(sc.pawnAccesses);
+            pawnHits.push_back(sc.pawnHits);
 
             std::cout << count << "\tbm: " << bestMoves << "   \tmove: " << move << "\t" << (correct ? "X" : " ") << std::endl;
             std::getline(file, line);
@@ -163,6 +224,7 @@ TEST_CASE("MoveTest", "[engine]")
 
     uint64_t totalTime = std::reduce(timesMs.begin(), timesMs.end());
     uint64_t totalAccesses = std::reduce(ttAccesses.begin(), ttAccesses.end());
+    uint64_t totalMoveCutOffs = std::reduce(moveCutOffs.begin(), moveCutOffs.end());
 
     std::cout
         << std::endl
@@ -177,9 +239,1244 @@ TEST_CASE("MoveTest", "[engine]")
         std::cout << "NPS:\t\t" << nps << "k" << std::endl;
     }
     std::cout << "Cut-offs:\t" << average(cutOffs) << std::endl;
+    std::cout << "Aspiration fails:\t" << std::reduce(failLows.begin(), failLows.end()) << " low, "
+              << std::reduce(failHighs.begin(), failHighs.end()) << " high" << std::endl;
+    if (totalMoveCutOffs != 0)
+    {
+        float firstRate = ((float)std::reduce(firstMoveCutOffs.begin(), firstMoveCutOffs.end())) / ((float)totalMoveCutOffs);
+        std::cout << "First move cut-offs:\t" << firstRate * 100 << "%" << std::endl;
+    }
+    std::cout << "Quiet generations:\t" << average(quietGenerations) << std::endl;
     if (totalAccesses != 0)
     {
         float ttHitRate = ((float)std::reduce(ttHits.begin(), ttHits.end())) / ((float)totalAccesses);
         std::cout << "TT hit rate:\t" << ttHitRate * 100 << "%" << std::endl;
     }
+    uint64_t totalPawnAccesses = std::reduce(pawnAccesses.begin(), pawnAccesses.end());
+    if (totalPawnAccesses != 0)
+    {
+        float pawnHitRate = ((float)std::reduce(pawnHits.begin(), pawnHits.end())) / ((float)totalPawnAccesses);
+        std::cout << "Pawn hit rate:\t" << pawnHitRate * 100 << "%" << std::endl;
+    }
+}
+
+TEST_CASE("SmpScalingTest", "[.benchmark]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::vector<std::string> fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "r1bq1rk1/p3bpp1/1p2p2p/2p5/3PN3/2PQPN1P/PPB2nP1/R5K1 w - - 0 19",
+        "2r2rk1/1b3p1p/p5p1/q2pb3/Pp6/3BP2P/1P1NQPP1/3R1RK1 w - - 0 1",
+    };
+    const engine::Depth depth = 9;
+    uint64_t baseTime = 0;
+
+    std::cout << "Time to depth " << (int)depth << std::endl;
+    std::cout << "Threads\tTime\tNodes\t\tNPS\tSpeedup" << std::endl;
+    for (int threads : {1, 2, 4, 8, 16})
+    {
+        uint64_t totalTime = 0;
+        uint64_t totalNodes = 0;
+        for (const auto &fen : fens)
+        {
+            engine::Position pos(fen);
+            engine::SearchManager sm;
+            engine::SearchDiagnostic sc;
+            sm.setThreads(threads);
+            sm.runIterativeDeepening(pos, depth, &sc);
+            totalTime += sc.timeMs;
+            totalNodes += sc.nodes;
+        }
+        totalTime = std::max<uint64_t>(totalTime, 1);
+        baseTime = threads == 1 ? totalTime : baseTime;
+
+        std::cout << threads << "\t" << totalTime << " ms\t" << totalNodes << "\t"
+                  << totalNodes / totalTime << "k\t" << (float)baseTime / (float)totalTime
+                  << "x" << std::endl;
+    }
+}
+
+TEST_CASE("TranspositionTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    // 3 MB is not a power of two amount of buckets
+    engine::TranspositionTable TT(3);
+    engine::TTEntry entry;
+    engine::Move move(engine::E2, engine::E4, engine::DOUBLE_PUSH);
+
+    REQUIRE(!TT.get(12345, entry));
+    TT.add(12345, 7, engine::LOWER_BOUND, move, -42);
+    REQUIRE(TT.get(12345, entry));
+    REQUIRE(entry.depth == 7);
+    REQUIRE(entry.type == engine::LOWER_BOUND);
+    REQUIRE(entry.hashMove == move);
+    REQUIRE(entry.eval == -42);
+
+    TT.resize(5);
+    REQUIRE(!TT.get(12345, entry));
+    REQUIRE(TT.getOccupancyRate() == 0);
+}
+
+TEST_CASE("MovePickerTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::vector<std::string> fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1",
+        "r3k2r/p1pp1pb1/bn2Qnp1/2qPN3/1p2P3/2N5/PPPBBPPP/R3K2R b KQkq - 3 2",
+        "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1",
+    };
+
+    // moves generated in the other positions are mostly not legal, so
+    // they check that the hash move and the killers are validated
+    std::vector<engine::Move> candidates = {engine::Move()};
+    for (const std::string &fen : fens)
+    {
+        engine::Position pos(fen);
+        engine::MoveList moveList;
+        engine::generateMoves<engine::ALL>(pos, moveList);
+        candidates.insert(candidates.end(), moveList.moves, moveList.moves + moveList.size);
+    }
+
+    int history[64][64] = {};
+    for (const std::string &fen : fens)
+    {
+        engine::Position pos(fen);
+        engine::MoveList moveList;
+        engine::generateMoves<engine::ALL>(pos, moveList);
+        std::vector<uint16_t> expected;
+        for (size_t i = 0; i < moveList.size; i++)
+            expected.push_back(moveList.moves[i].raw());
+        std::sort(expected.begin(), expected.end());
+
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            engine::Killers killers;
+            killers.moveA = candidates[(i + 1) % candidates.size()];
+            killers.moveB = candidates[(i + 2) % candidates.size()];
+            engine::MovePicker picker(pos, candidates[i], killers, history);
+
+            std::vector<uint16_t> picked;
+            for (engine::Move move = picker.next(); move.isValid(); move = picker.next())
+                picked.push_back(move.raw());
+            std::sort(picked.begin(), picked.end());
+            REQUIRE(picked == expected);
+        }
+    }
+}
+
+TEST_CASE("CheckInfoTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::vector<std::string> fens = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1",
+        "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1",
+    };
+
+    // the check information kept through makeTurn and unmakeTurn
+    // must match the one computed from scratch for the same position
+    auto requireSameCheckInfo = [](const engine::Position &pos)
+    {
+        engine::Position fresh(pos.getFen());
+        REQUIRE(pos.getCheckersBB() == fresh.getCheckersBB());
+        REQUIRE(pos.getPinnedBB() == fresh.getPinnedBB());
+        REQUIRE(pos.getKingDangerBB() == fresh.getKingDangerBB());
+    };
+
+    for (const std::string &fen : fens)
+    {
+        engine::Position pos(fen);
+        engine::RevertState state1, state2;
+        engine::MoveList moveList;
+        engine::generateMoves<engine::ALL>(pos, moveList);
+
+        for (size_t i = 0; i < moveList.size; i++)
+        {
+            pos.makeTurn(moveList.moves[i], &state1);
+            requireSameCheckInfo(pos);
+
+            engine::MoveList replies;
+            engine::generateMoves<engine::ALL>(pos, replies);
+            for (size_t j = 0; j < replies.size; j++)
+            {
+                pos.makeTurn(replies.moves[j], &state2);
+                requireSameCheckInfo(pos);
+                pos.unmakeTurn();
+            }
+            pos.unmakeTurn();
+            requireSameCheckInfo(pos);
+        }
+    }
+}
+
+TEST_CASE("RepetitionTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    engine::Position pos(engine::START_FEN);
+    engine::Move knightMoves[4] = {
+        engine::Move(engine::G1, engine::F3), engine::Move(engine::G8, engine::F6),
+        engine::Move(engine::F3, engine::G1), engine::Move(engine::F6, engine::G8)};
+
+    // the start position occurs for the second and then the third time
+    for (engine::Move move : knightMoves)
+        pos.makeTurn(move);
+    REQUIRE(!pos.isRepeated());
+    for (engine::Move move : knightMoves)
+        pos.makeTurn(move);
+    REQUIRE(pos.isRepeated());
+
+    // pawn moves make the previous positions unreachable
+    pos.makeTurn(engine::Move(engine::E2, engine::E3));
+    pos.makeTurn(engine::Move(engine::E7, engine::E6));
+    engine::RevertState states[8];
+    for (int i = 0; i < 8; i++)
+    {
+        pos.makeTurn(knightMoves[i % 4], &states[i]);
+        REQUIRE(pos.isRepeated() == (i == 7));
+    }
+    for (int i = 0; i < 4; i++)
+        pos.unmakeTurn();
+    REQUIRE(!pos.isRepeated());
+
+    // two null moves give back the same position, but it doesn't count
+    engine::RevertState nullStates[2];
+    pos.makeNullMove(&nullStates[0]);
+    pos.makeNullMove(&nullStates[1]);
+    REQUIRE(!pos.isRepeated());
+    pos.unmakeNullMove();
+    pos.unmakeNullMove();
+}
+
+TEST_CASE("PawnStructureTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    // isolated and passed
+    REQUIRE(engine::evaluatePawns(engine::Position("4k3/8/8/8/8/8/P7/4K3 w - - 0 1")) == -15 + 5);
+    // doubled and isolated, only the front pawn is passed
+    REQUIRE(engine::evaluatePawns(engine::Position("4k3/8/8/8/8/P7/P7/4K3 w - - 0 1")) == -30 + 10 - 10);
+    // white e3 is backward and d4 passed, black f5 is isolated
+    REQUIRE(engine::evaluatePawns(engine::Position("4k3/8/8/5p2/3P4/4P3/8/4K3 w - - 0 1")) == 20 - 8 + 15);
+    // a full shelter in front of the king, and then an open file next to it
+    REQUIRE(engine::evaluateShelter(engine::Position("6k1/8/8/8/8/8/5PPP/6K1 w - - 0 1"), engine::WHITE) == 30);
+    REQUIRE(engine::evaluateShelter(engine::Position("6k1/8/8/8/8/7P/5P2/6K1 w - - 0 1"), engine::WHITE) == 10 - 20 + 5);
+
+    // the pawn key follows the pawns only, and is restored by unmakeTurn
+    engine::Position pos("4k3/8/8/3p4/4P3/8/8/R3K3 w - - 0 1");
+    engine::Key pawnKey = pos.getPawnKey();
+    engine::RevertState state1, state2;
+    pos.makeTurn(engine::Move(engine::A1, engine::A2), &state1);
+    REQUIRE(pos.getPawnKey() == pawnKey);
+    pos.makeTurn(engine::Move(engine::D5, engine::E4, engine::CAPTURE), &state2);
+    REQUIRE(pos.getPawnKey() == engine::Position(pos.getFen()).getPawnKey());
+    pos.unmakeTurn();
+    pos.unmakeTurn();
+    REQUIRE(pos.getPawnKey() == pawnKey);
+}
+
+TEST_CASE("SeeTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    // (fen, move, exchange value)
+    std::vector<std::tuple<std::string, engine::Move, int>> testCases = {
+        // undefended pawn
+        std::make_tuple("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1",
+                        engine::Move(engine::E1, engine::E5, engine::CAPTURE), 100),
+        // queen takes a pawn defended by a pawn
+        std::make_tuple("4k3/8/3p4/4p3/8/8/8/4QK2 w - - 0 1",
+                        engine::Move(engine::E1, engine::E5, engine::CAPTURE), 100 - 900),
+        // x-rays on both sides: NxP NxN RxN BxR QxB QxQ, white stops after RxN
+        std::make_tuple("1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1",
+                        engine::Move(engine::D3, engine::E5, engine::CAPTURE), -200),
+        // the king can't recapture while the tile is still attacked
+        std::make_tuple("4k3/8/8/8/8/8/3r4/3RK3 b - - 0 1",
+                        engine::Move(engine::D2, engine::D1, engine::CAPTURE), 0),
+        std::make_tuple("3rk3/8/8/8/8/8/3r4/3RK3 b - - 0 1",
+                        engine::Move(engine::D2, engine::D1, engine::CAPTURE), 500),
+        std::make_tuple("3rk3/8/8/8/8/8/3r4/2RRK3 b - - 0 1",
+                        engine::Move(engine::D2, engine::D1, engine::CAPTURE), 0),
+        // en passant
+        std::make_tuple("4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1",
+                        engine::Move(engine::E5, engine::D6, engine::EN_PASSANT), 100),
+    };
+
+    for (const auto &testCase : testCases)
+    {
+        std::string fen;
+        engine::Move move;
+        int value;
+        std::tie(fen, move, value) = testCase;
+
+        engine::Position pos(fen);
+        REQUIRE(engine::see(pos, move, value));
+        REQUIRE(!engine::see(pos, move, value + 1));
+    }
+}
+
+TEST_CASE("PvTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::vector<std::tuple<std::string, int>> testCases = {
+        std::make_tuple("5r2/p1p3R1/2pk4/2Np3p/3Pp3/2P5/PP3rP1/6K1 w - - 0 39", 1),
+        std::make_tuple("r1bq1rk1/p3bpp1/1p2p2p/2p5/3PN3/2PQPN1P/PPB2nP1/R5K1 w - - 0 19", 2),
+        std::make_tuple("8/R3B3/6k1/6pp/6Pn/4P3/PP3P1K/6r1 b - - 2 33", 2),
+        std::make_tuple(engine::START_FEN, 0),
+    };
+
+    for (const auto &testCase : testCases)
+    {
+        std::string fen;
+        int mateMoves;
+        std::tie(fen, mateMoves) = testCase;
+
+        engine::Position pos(fen);
+        engine::SearchManager sm;
+        InfoListener listener;
+        sm.setListener(&listener);
+        engine::Move bestMove = sm.runIterativeDeepening(pos, 6);
+
+        const engine::SearchInfo &info = listener.info;
+        REQUIRE(info.depth == 6);
+        REQUIRE(info.selDepth >= info.depth);
+        REQUIRE(info.qNodes <= info.nodes);
+        REQUIRE(!info.pv.empty());
+        REQUIRE(info.pv[0] == bestMove);
+        REQUIRE(info.isMate() == (mateMoves != 0));
+        if (mateMoves != 0)
+        {
+            REQUIRE(info.getMateMoves() == mateMoves);
+            REQUIRE(info.pv.size() == size_t(2 * mateMoves - 1));
+        }
+
+        // every move of the variation is legal, and a mate variation ends in mate
+        for (engine::Move move : info.pv)
+        {
+            engine::MoveList moveList;
+            engine::generateMoves<engine::ALL>(pos, moveList);
+            REQUIRE(std::find(moveList.moves, moveList.moves + moveList.size, move) !=
+                    moveList.moves + moveList.size);
+            pos.makeTurn(move);
+        }
+        if (mateMoves != 0)
+        {
+            engine::MoveList moveList;
+            engine::generateMoves<engine::ALL>(pos, moveList);
+            REQUIRE(moveList.size == 0);
+            REQUIRE(pos.isKingInCheck());
+        }
+    }
+}
+
+TEST_CASE("NoRootMovesTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    // a mated and a stalemated root
+    std::vector<std::tuple<std::string, bool>> testCases = {
+        std::make_tuple("7k/6Q1/6K1/8/8/8/8/8 b - - 0 1", true),
+        std::make_tuple("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1", false),
+    };
+
+    for (const auto &testCase : testCases)
+    {
+        std::string fen;
+        bool mated;
+        std::tie(fen, mated) = testCase;
+
+        engine::Position pos(fen);
+        engine::SearchManager sm;
+        InfoListener listener;
+        sm.setListener(&listener);
+        engine::ThinkInfo info;
+        info.flags = engine::F_DEPTH;
+        info.depth = 6;
+        sm.resetStop();
+
+        // the search must end by itself, a stop is only sent if it hangs
+        std::thread thread([&]() { sm.startSearch(pos, &info); });
+        auto begin = std::chrono::steady_clock::now();
+        while (!listener.done && engine::getTimeMs(begin, std::chrono::steady_clock::now()) < 5000)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        bool done = listener.done;
+        sm.stop();
+        thread.join();
+
+        REQUIRE(done);
+        REQUIRE(listener.info.depth == 6);
+        REQUIRE(listener.info.score == (mated ? engine::MIN_EVAL : 0));
+    }
+}
+
+TEST_CASE("StopTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    engine::Position pos("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+    engine::SearchManager sm;
+    InfoListener listener;
+    sm.setListener(&listener);
+
+    // the depth limit is exact
+    engine::ThinkInfo info;
+    info.flags = engine::F_DEPTH;
+    info.depth = 5;
+    sm.resetStop();
+    sm.startSearch(pos, &info);
+    REQUIRE(listener.info.depth == 5);
+    REQUIRE(listener.bestMove.isValid());
+
+    // the node limit is never passed
+    info.flags = engine::F_NODES;
+    info.nodes = 20000;
+    sm.resetStop();
+    sm.startSearch(pos, &info);
+    REQUIRE(listener.info.nodes <= 20000);
+
+    // a stop sent before the search thread starts searching is not lost
+    info.flags = engine::F_INFINITE;
+    sm.resetStop();
+    sm.stop();
+    listener.bestMove = engine::Move();
+    sm.startSearch(pos, &info);
+    REQUIRE(listener.bestMove.isValid());
+
+    // a stop from another thread ends an infinite search
+    sm.resetStop();
+    std::thread thread([&]() { sm.startSearch(pos, &info); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto begin = std::chrono::steady_clock::now();
+    sm.stop();
+    thread.join();
+    REQUIRE(engine::getTimeMs(begin, std::chrono::steady_clock::now()) < 1000);
+    REQUIRE(listener.bestMove.isValid());
+}
+
+TEST_CASE("PonderTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    engine::Position pos("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+    engine::SearchManager sm;
+    InfoListener listener;
+    sm.setListener(&listener);
+
+    // a 1 s clock leaves well under 200 ms for the move
+    engine::ThinkInfo info;
+    info.task = engine::PONDER;
+    info.flags = engine::F_TIME;
+    info.time[engine::WHITE] = 1000;
+    info.time[engine::BLACK] = 1000;
+
+    // pondering ignores the clock and goes on until the ponder hit, then
+    // the search switches to the clock without starting over
+    sm.resetStop(true);
+    std::thread thread([&]() { sm.startSearch(pos, &info); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    REQUIRE(!listener.done);
+    sm.ponderHit();
+    thread.join();
+    REQUIRE(listener.bestMove.isValid());
+
+    // the ponder move is the legal reply from the principal variation
+    REQUIRE(listener.ponderMove.isValid());
+    REQUIRE(listener.info.pv.size() >= 2);
+    REQUIRE(listener.info.pv[0] == listener.bestMove);
+    REQUIRE(listener.info.pv[1] == listener.ponderMove);
+    engine::Position next = pos;
+    next.makeTurn(listener.bestMove);
+    REQUIRE(engine::isPseudoLegal(next, listener.ponderMove));
+    REQUIRE(engine::isLegal(next, listener.ponderMove));
+
+    // a ponder miss is a stop, which ends the search at once
+    listener.done = false;
+    sm.resetStop(true);
+    thread = std::thread([&]() { sm.startSearch(pos, &info); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    REQUIRE(!listener.done);
+    auto begin = std::chrono::steady_clock::now();
+    sm.stop();
+    thread.join();
+    REQUIRE(engine::getTimeMs(begin, std::chrono::steady_clock::now()) < 1000);
+    REQUIRE(listener.done);
+}
+
+TEST_CASE("TimeManagerTest", "[engine]")
+{
+    engine::TimeManager timeManager;
+    engine::ThinkInfo info;
+
+    // with a clock the soft limit is a share of it, the hard limit a multiple of that
+    info.flags = engine::F_TIME | engine::F_INC;
+    info.time[engine::WHITE] = 10000 + engine::MOVE_OVERHEAD_MS;
+    info.time[engine::BLACK] = 100;
+    info.increment[engine::WHITE] = 100;
+    info.increment[engine::BLACK] = 100;
+    timeManager.start(info, engine::WHITE);
+    REQUIRE(timeManager.getSoftLimitMs() == 10000 / engine::DEFAULT_MOVESTOGO + 100);
+    REQUIRE(timeManager.getHardLimitMs() == timeManager.getSoftLimitMs() * engine::HARD_LIMIT_SCALE);
+    REQUIRE(!timeManager.isHardLimitReached());
+
+    // the hard limit leaves time on a short clock
+    timeManager.start(info, engine::BLACK);
+    REQUIRE(timeManager.getHardLimitMs() < 100 - engine::MOVE_OVERHEAD_MS);
+    REQUIRE(timeManager.getSoftLimitMs() <= timeManager.getHardLimitMs());
+
+    // a move time is used whole, without stopping between iterations
+    info.flags = engine::F_MOVETIME;
+    info.moveTime = 500;
+    timeManager.start(info, engine::WHITE);
+    REQUIRE(timeManager.getSoftLimitMs() == 500);
+    REQUIRE(timeManager.getHardLimitMs() == 500);
+    REQUIRE(!timeManager.shouldStopAfterIteration(engine::Move(), 0));
+
+    // no time limit without a clock or a move time
+    info.flags = engine::F_INFINITE;
+    timeManager.start(info, engine::WHITE);
+    REQUIRE(!timeManager.isHardLimitReached());
+    REQUIRE(!timeManager.shouldStopAfterIteration(engine::Move(), 0));
+}
+
+TEST_CASE("StartupLatencyTest", "[.benchmark]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    engine::Position pos(engine::START_FEN);
+
+    std::cout << "Hash\tClear (1 thread)\tClear (" << threads << " threads)\tMove startup" << std::endl;
+    for (size_t megabytes : {256, 1024})
+    {
+        engine::TranspositionTable TT(megabytes);
+        auto begin = std::chrono::steady_clock::now();
+        TT.clear(1);
+        auto serialTime = engine::getTimeMs(begin, std::chrono::steady_clock::now());
+        begin = std::chrono::steady_clock::now();
+        TT.clear(threads);
+        auto parallelTime = engine::getTimeMs(begin, std::chrono::steady_clock::now());
+
+        // a depth 1 search is almost only the startup work done before every move
+        engine::SearchManager sm;
+        sm.setHashSize(megabytes);
+        sm.runIterativeDeepening(pos, 1);
+        begin = std::chrono::steady_clock::now();
+        sm.runIterativeDeepening(pos, 1);
+        auto startupTime = engine::getTimeMs(begin, std::chrono::steady_clock::now());
+
+        std::cout << megabytes << " MB\t" << serialTime << " ms\t\t\t" << parallelTime << " ms\t\t\t"
+                  << startupTime << " ms" << std::endl;
+    }
+}
+
+TEST_CASE("PersistentStateTest", "[.benchmark]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    // Morphy vs Duke Karl / Count Isouard, Paris 1858
+    std::vector<std::string> game = {
+        "e2e4", "e7e5", "g1f3", "d7d6", "d2d4", "c8g4", "d4e5", "g4f3", "d1f3", "d6e5",
+        "f1c4", "g8f6", "f3b3", "d8e7", "b1c3", "c7c6", "c1g5", "b7b5", "c3b5", "c6b5",
+        "c4b5", "b8d7", "e1c1", "a8d8", "d1d7", "d8d7", "h1d1", "e7e6", "b5d7", "f6d7"};
+    const engine::Depth depth = 8;
+
+    for (bool persistent : {false, true})
+    {
+        engine::Position pos(engine::START_FEN);
+        engine::SearchManager sm;
+        uint64_t totalNodes = 0;
+        uint64_t totalTime = 0;
+
+        for (const auto &uciMove : game)
+        {
+            if (!persistent)
+                sm.clear();
+            engine::SearchDiagnostic sc;
+            sm.runIterativeDeepening(pos, depth, &sc);
+            totalNodes += sc.nodes;
+            totalTime += sc.timeMs;
+
+            engine::MoveList moveList;
+            engine::generateMoves<engine::ALL>(pos, moveList);
+            for (size_t i = 0; i < moveList.size; i++)
+                if (engine::moveToUci(moveList.moves[i]) == uciMove)
+                    pos.makeTurn(moveList.moves[i]);
+        }
+
+        std::cout << (persistent ? "Persistent" : "Cleared") << " state, depth " << (int)depth
+                  << " on every move: " << totalNodes << " nodes, " << totalTime << " ms" << std::endl;
+    }
+}
+
+TEST_CASE("QSearchBenchmark", "[.benchmark]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::vector<std::string> fens;
+    std::ifstream file("../../testsuites/wac201.epd");
+    std::string line;
+    while (std::getline(file, line))
+        fens.push_back(line.substr(0, line.find("bm")));
+
+    // shallow searches spend most of their nodes in the quiescence search
+    engine::SearchManager sm;
+    uint64_t totalNodes = 0;
+    uint64_t totalQNodes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 20; i++)
+    {
+        for (const std::string &fen : fens)
+        {
+            engine::Position pos(fen);
+            engine::SearchDiagnostic sc;
+            sm.runIterativeDeepening(pos, 3, &sc);
+            totalNodes += sc.nodes;
+            totalQNodes += sc.qNodes;
+        }
+    }
+    uint64_t totalTime = std::max<uint64_t>(1, engine::getTimeMs(start, std::chrono::steady_clock::now()));
+
+    std::cout << "Depth 3 on " << fens.size() << " positions, 20 times: " << totalNodes << " nodes ("
+              << totalQNodes << " q nodes), " << totalTime << " ms, "
+              << totalNodes / totalTime << "k nps" << std::endl;
+}
+
+TEST_CASE("FixedTimeDepthBenchmark", "[.benchmark]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::vector<std::string> fens;
+    std::ifstream file("../../testsuites/midgames250.epd");
+    std::string line;
+    while (std::getline(file, line))
+        fens.push_back(line.substr(0, line.find("bm")));
+
+    const int moveTime = 100;
+    std::vector<uint64_t> depths;
+    std::vector<uint64_t> nodes;
+    for (const std::string &fen : fens)
+    {
+        engine::Position pos(fen);
+        engine::SearchManager sm;
+        InfoListener listener;
+        engine::ThinkInfo info;
+        info.flags = engine::F_MOVETIME;
+        info.moveTime = moveTime;
+        sm.setListener(&listener);
+        sm.startSearch(pos, &info);
+        depths.push_back(listener.info.depth);
+        nodes.push_back(listener.info.nodes);
+    }
+
+    uint64_t totalDepth = std::reduce(depths.begin(), depths.end());
+    std::cout << moveTime << " ms on " << fens.size() << " positions: average depth "
+              << (float)totalDepth / (float)std::max<size_t>(1, fens.size()) << ", "
+              << average(nodes) << " nodes" << std::endl;
+}
+
+TEST_CASE("TimeManagementBenchmark", "[.benchmark]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::vector<std::string> fens;
+    std::ifstream file("../../testsuites/midgames250.epd");
+    std::string line;
+    while (std::getline(file, line))
+        fens.push_back(line.substr(0, line.find("bm")) + " 0 1");
+
+    // self-play games with a real clock, both sides use the engine's time management
+    const int maxPlies = 160;
+    for (auto [baseMs, incMs, games] : {std::make_tuple(10000, 100, 6), std::make_tuple(60000, 600, 2)})
+    {
+        int flags = 0;
+        int moves = 0;
+        uint64_t spentMs = 0;
+        uint64_t unfinishedMs = 0;
+        std::vector<float> usage;
+        std::vector<float> gameUsage;
+
+        for (int game = 0; game < games; game++)
+        {
+            engine::Position pos(fens[game * 7 % fens.size()]);
+            engine::SearchManager sm[2];
+            InfoListener listener[2];
+            int clock[2] = {baseMs, baseMs};
+            int sideMoves[2] = {0, 0};
+            int sideSpent[2] = {0, 0};
+            for (engine::Color color : {engine::WHITE, engine::BLACK})
+                sm[color].setListener(&listener[color]);
+
+            for (int ply = 0; ply < maxPlies; ply++)
+            {
+                engine::MoveList moveList;
+                engine::generateMoves<engine::ALL>(pos, moveList);
+                if (moveList.size == 0 || pos.getHalfMove() >= 100 || pos.isRepeated())
+                    break;
+
+                engine::Color side = pos.getTurn();
+                engine::ThinkInfo info;
+                info.flags = engine::F_TIME | engine::F_INC;
+                info.time[engine::WHITE] = clock[engine::WHITE];
+                info.time[engine::BLACK] = clock[engine::BLACK];
+                info.increment[engine::WHITE] = incMs;
+                info.increment[engine::BLACK] = incMs;
+
+                listener[side].info = {};
+                auto begin = std::chrono::steady_clock::now();
+                sm[side].resetStop();
+                sm[side].startSearch(pos, &info);
+                int elapsed = engine::getTimeMs(begin, std::chrono::steady_clock::now());
+
+                // time spent on the last iteration, which was stopped before it completed
+                unfinishedMs += std::max<int>(0, elapsed - listener[side].info.timeMs);
+                moves++;
+                sideMoves[side]++;
+                sideSpent[side] += elapsed;
+                spentMs += elapsed;
+                usage.push_back((float)elapsed / (float)clock[side]);
+                clock[side] -= elapsed;
+                if (clock[side] < 0)
+                {
+                    flags++;
+                    break;
+                }
+                clock[side] += incMs;
+                pos.makeTurn(listener[side].bestMove);
+            }
+            // share of the whole budget of the game each side has used at the end
+            for (engine::Color color : {engine::WHITE, engine::BLACK})
+                gameUsage.push_back((float)sideSpent[color] / (float)(baseMs + incMs * sideMoves[color]));
+        }
+
+        std::sort(usage.begin(), usage.end());
+        auto percentile = [&](float p)
+        { return usage.empty() ? 0.0f : 100 * usage[std::min(usage.size() - 1, size_t(p * usage.size()))]; };
+        std::cout << baseMs / 1000 << "+" << incMs / 1000.0f << ": " << games << " games, " << moves
+                  << " moves, flag rate " << 100.0f * flags / games << "%, "
+                  << spentMs / std::max(1, moves) << " ms per move, "
+                  << 100.0f * unfinishedMs / std::max<uint64_t>(1, spentMs) << "% of it in unfinished iterations"
+                  << std::endl;
+        std::cout << "  share of the remaining clock per move: p10 " << percentile(0.1f) << "%, p50 "
+                  << percentile(0.5f) << "%, p90 " << percentile(0.9f) << "%, max " << percentile(1.0f)
+                  << "%" << std::endl;
+        std::cout << "  share of the game budget used by each side: min "
+                  << 100 * *std::min_element(gameUsage.begin(), gameUsage.end()) << "%, max "
+                  << 100 * *std::max_element(gameUsage.begin(), gameUsage.end()) << "%" << std::endl;
+    }
+}
+
+// Write the entries sorted by key, as a Polyglot book
+void writeBook(const std::string &fileName, std::vector<engine::BookEntry> entries)
+{
+    std::sort(entries.begin(), entries.end(), [](const engine::BookEntry &a, const engine::BookEntry &b)
+              { return a.key < b.key; });
+
+    std::ofstream file(fileName, std::ios::binary);
+    for (const auto &entry : entries)
+    {
+        uint64_t fields[3] = {entry.key, entry.move, entry.weight};
+        int sizes[3] = {8, 2, 2};
+        for (int i = 0; i < 3; i++)
+            for (int byte = sizes[i] - 1; byte >= 0; byte--)
+                file.put((char)(fields[i] >> (8 * byte)));
+        for (int byte = 0; byte < 4; byte++)
+            file.put(0);
+    }
+}
+
+engine::BookEntry makeBookEntry(engine::Position &pos, engine::Move move, uint16_t weight)
+{
+    return {engine::getPolyglotKey(pos), engine::toPolyglotMove(move), weight, 0};
+}
+
+engine::Move findMove(engine::Position &pos, const std::string &uci)
+{
+    engine::MoveList moveList;
+    engine::generateMoves<engine::ALL>(pos, moveList);
+    for (size_t i = 0; i < moveList.size; i++)
+        if (moveToUci(moveList.moves[i]) == uci)
+            return moveList.moves[i];
+    return engine::Move();
+}
+
+TEST_CASE("BookTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    // the keys of the Polyglot book format specification
+    std::vector<std::tuple<std::string, engine::Key>> keys = {
+        std::make_tuple(engine::START_FEN, 0x463b96181691fc9cULL),
+        std::make_tuple("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ULL),
+        std::make_tuple("rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ULL),
+        std::make_tuple("rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ULL),
+        std::make_tuple("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ULL),
+        std::make_tuple("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ULL),
+        std::make_tuple("rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ULL),
+        std::make_tuple("rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ULL),
+        std::make_tuple("rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ULL),
+    };
+    for (const auto &[fen, key] : keys)
+    {
+        REQUIRE(engine::getPolyglotKey(engine::Position(fen)) == key);
+    }
+
+    // the en passant file only counts when a pawn can take on it
+    engine::Position noCapture("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+    REQUIRE(engine::getPolyglotKey(noCapture) ==
+            engine::getPolyglotKey(engine::Position("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1")));
+    engine::Position capture("rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+    REQUIRE(engine::getPolyglotKey(capture) !=
+            engine::getPolyglotKey(engine::Position("rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1")));
+
+    engine::Position start(engine::START_FEN);
+    engine::Position castle("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1");
+    std::vector<engine::BookEntry> entries = {
+        makeBookEntry(start, findMove(start, "e2e4"), 10),
+        makeBookEntry(start, findMove(start, "d2d4"), 30),
+        makeBookEntry(start, findMove(start, "g1f3"), 0),
+        makeBookEntry(castle, findMove(castle, "e1g1"), 1),
+    };
+    // a move that is not legal in the position comes from a key collision
+    entries.push_back({engine::getPolyglotKey(start), 0x0dd4, 100});
+
+    std::string fileName = (std::filesystem::temp_directory_path() / "rooster_book_test.bin").string();
+    writeBook(fileName, entries);
+
+    engine::Book book;
+    REQUIRE(!book.open(fileName + ".missing"));
+    REQUIRE(book.open(fileName));
+    REQUIRE(book.size() == entries.size());
+
+    REQUIRE(moveToUci(book.probe(start, true)) == "d2d4");
+    REQUIRE(moveToUci(book.probe(castle)) == "e1g1");
+    REQUIRE(book.probe(castle).getFlag() == engine::KING_CASTLE);
+    REQUIRE(!book.probe(noCapture).isValid());
+
+    // the moves are drawn by weight, and moves without weight are never played
+    int d4 = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        std::string move = moveToUci(book.probe(start));
+        REQUIRE((move == "e2e4" || move == "d2d4"));
+        d4 += move == "d2d4";
+    }
+    REQUIRE(d4 > 650);
+    REQUIRE(d4 < 850);
+
+    book.close();
+    REQUIRE(!book.probe(start).isValid());
+    std::filesystem::remove(fileName);
+}
+
+TEST_CASE("BookProbeBenchmark", "[.benchmark]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    // positions from random games, half of them in a book of a million entries
+    std::mt19937 random(1);
+    std::vector<std::string> fens;
+    std::vector<engine::BookEntry> entries;
+    while (fens.size() < 2000)
+    {
+        engine::Position pos(engine::START_FEN);
+        for (int ply = 0; ply < 20; ply++)
+        {
+            engine::MoveList moveList;
+            engine::generateMoves<engine::ALL>(pos, moveList);
+            if (moveList.size == 0)
+                break;
+            engine::Move move = moveList.moves[random() % moveList.size];
+            if (fens.size() % 2 == 0)
+                entries.push_back(makeBookEntry(pos, move, 1));
+            fens.push_back(pos.getFen());
+            pos.makeTurn(move);
+        }
+    }
+    std::uniform_int_distribution<uint64_t> keys;
+    while (entries.size() < 1000000)
+        entries.push_back({keys(random), 0, 1, 0});
+
+    std::string fileName = (std::filesystem::temp_directory_path() / "rooster_book_bench.bin").string();
+    writeBook(fileName, entries);
+
+    engine::Book book;
+    REQUIRE(book.open(fileName));
+    std::vector<engine::Position> positions;
+    for (const auto &fen : fens)
+        positions.emplace_back(fen);
+
+    const int rounds = 50;
+    int hits = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++)
+        for (auto &pos : positions)
+            hits += book.probe(pos).isValid();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count() / (rounds * positions.size());
+
+    begin = std::chrono::steady_clock::now();
+    uint64_t keySum = 0;
+    for (int round = 0; round < rounds; round++)
+        for (auto &pos : positions)
+            keySum += engine::getPolyglotKey(pos);
+    end = std::chrono::steady_clock::now();
+    double keyNs = std::chrono::duration<double, std::nano>(end - begin).count() / (rounds * positions.size());
+
+    std::cout << entries.size() << " entries, " << positions.size() << " positions, "
+              << 100.0 * hits / (rounds * positions.size()) << "% hits" << std::endl;
+    std::cout << "probe: " << ns << " ns, of which key: " << keyNs << " ns (" << keySum % 2 << ")" << std::endl;
+
+    book.close();
+    std::filesystem::remove(fileName);
+}
+
+// FEN of a position with the given pieces, and no castling or en passant
+std::string makeFen(const std::vector<std::pair<engine::Piece, engine::Tile>> &pieces, engine::Color turn)
+{
+    const std::string symbols = " PNBRQK  pnbrqk";
+    std::string board(64, ' ');
+    for (auto [piece, tile] : pieces)
+        board[tile] = symbols[piece];
+
+    std::string fen;
+    for (int rank = 7; rank >= 0; rank--)
+    {
+        int empty = 0;
+        for (int file = 0; file < 8; file++)
+        {
+            char c = board[rank * 8 + file];
+            if (c == ' ')
+            {
+                empty++;
+                continue;
+            }
+            if (empty)
+                fen += std::to_string(empty);
+            fen += c;
+            empty = 0;
+        }
+        if (empty)
+            fen += std::to_string(empty);
+        fen += rank ? "/" : "";
+    }
+    return fen + (turn == engine::WHITE ? " w" : " b") + " - - 0 1";
+}
+
+// The score of a position one move deeper agrees with the table: the side to
+// move wins if a move leaves the other side lost, and loses if all its moves
+// leave the other side winning. Positions out of the tables are draws
+void checkBitbaseConsistency(const std::vector<engine::PieceType> &strongPieces, int samples, std::mt19937 &random)
+{
+    int checked = 0;
+    while (checked < samples)
+    {
+        engine::Color strong = engine::Color(random() % 2);
+        std::vector<engine::Piece> pieces = {engine::makePiece(engine::KING, strong),
+                                             engine::makePiece(engine::KING, ~strong)};
+        for (engine::PieceType pt : strongPieces)
+            pieces.push_back(engine::makePiece(pt, strong));
+
+        std::vector<engine::Tile> tiles;
+        for (int tile = 0; tile < 64; tile++)
+            tiles.push_back(engine::Tile(tile));
+        std::shuffle(tiles.begin(), tiles.end(), random);
+        std::vector<std::pair<engine::Piece, engine::Tile>> placed;
+        bool legal = true;
+        for (size_t i = 0; i < pieces.size(); i++)
+        {
+            placed.push_back({pieces[i], tiles[i]});
+            legal &= engine::typeOf(pieces[i]) != engine::PAWN ||
+                     (engine::rankOf(tiles[i]) != engine::RANK_1 && engine::rankOf(tiles[i]) != engine::RANK_8);
+        }
+        legal &= !(engine::getAttacksBB<engine::KING>(tiles[0]) & engine::tileBB(tiles[1]));
+        if (!legal)
+            continue;
+
+        engine::Color turn = engine::Color(random() % 2);
+        engine::Position pos(makeFen(placed, turn));
+        if (pos.isKingInCheck(~turn))
+            continue;
+
+        engine::Eval score;
+        REQUIRE(engine::bitbase::probe(pos, score));
+
+        engine::MoveList moveList;
+        engine::generateMoves<engine::ALL>(pos, moveList);
+        bool win = false, loss = moveList.size > 0 || pos.isKingInCheck();
+        for (size_t i = 0; i < moveList.size; i++)
+        {
+            engine::RevertState state;
+            pos.makeTurn(moveList.moves[i], &state);
+            engine::Eval next = 0;
+            engine::bitbase::probe(pos, next);
+            win |= next < 0;
+            loss &= next > 0;
+            pos.unmakeTurn();
+        }
+        if (moveList.size == 0 && pos.isKingInCheck())
+            loss = true;
+
+        INFO(pos.getFen());
+        REQUIRE((score > 0) == win);
+        REQUIRE((score < 0) == loss);
+        checked++;
+    }
+}
+
+TEST_CASE("BitbaseTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+    engine::bitbase::clear();
+    engine::bitbase::generate(2, false);
+    REQUIRE(engine::bitbase::isAvailable(engine::KPK));
+    REQUIRE(!engine::bitbase::isAvailable(engine::KBNK));
+
+    auto probe = [](const std::string &fen)
+    {
+        engine::Eval score = 1;
+        REQUIRE(engine::bitbase::probe(engine::Position(fen), score));
+        return score;
+    };
+    // stalemate, the pawn is taken, and the pawn runs from the king
+    REQUIRE(probe("4k3/4P3/4K3/8/8/8/8/8 b - - 0 1") == 0);
+    REQUIRE(probe("8/8/8/8/8/8/3kP3/7K b - - 0 1") == 0);
+    REQUIRE(probe("8/8/8/8/8/8/4P3/4K2k w - - 0 1") > 0);
+    REQUIRE(probe("8/8/8/8/8/8/4p3/4k2K w - - 0 1") < 0);
+    // the rook is taken unless it is defended
+    REQUIRE(probe("8/8/8/8/8/8/2r5/3K3k w - - 0 1") == 0);
+    REQUIRE(probe("8/8/8/8/8/8/1r6/1k1K4 w - - 0 1") < 0);
+    REQUIRE(probe("8/8/8/8/8/3K4/3Q4/k7 w - - 0 1") > 0);
+
+    std::mt19937 random(1);
+    checkBitbaseConsistency({engine::PAWN}, 3000, random);
+    checkBitbaseConsistency({engine::ROOK}, 1000, random);
+    checkBitbaseConsistency({engine::QUEEN}, 1000, random);
+
+    // the saved file maps to the same tables
+    std::string fileName = (std::filesystem::temp_directory_path() / "rooster_bitbase_test.bin").string();
+    REQUIRE(engine::bitbase::save(fileName));
+    REQUIRE(!engine::bitbase::load(fileName + ".missing"));
+    REQUIRE(engine::bitbase::load(fileName));
+    REQUIRE(engine::bitbase::isAvailable(engine::KRK));
+    REQUIRE(probe("8/8/8/8/8/8/1r6/1k1K4 w - - 0 1") < 0);
+    checkBitbaseConsistency({engine::PAWN}, 1000, random);
+
+    engine::bitbase::clear();
+    engine::Eval score;
+    REQUIRE(!engine::bitbase::probe(engine::Position("8/8/8/8/8/8/4P3/4K2k w - - 0 1"), score));
+    std::filesystem::remove(fileName);
+}
+
+TEST_CASE("BitbaseBenchmark", "[.benchmark]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+    engine::bitbase::clear();
+
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    auto begin = std::chrono::steady_clock::now();
+    engine::bitbase::generate(threads);
+    auto end = std::chrono::steady_clock::now();
+    size_t bytes = 0;
+    for (int id = 0; id < engine::BITBASE_COUNT; id++)
+        bytes += engine::bitbase::getTableBytes(engine::BitbaseId(id));
+    std::cout << "generation: " << std::chrono::duration<double, std::milli>(end - begin).count() << " ms on "
+              << threads << " threads, " << bytes << " bytes" << std::endl;
+
+    std::mt19937 random(2);
+    checkBitbaseConsistency({engine::BISHOP, engine::KNIGHT}, 3000, random);
+
+    // probes of the endgames, and of middlegame positions that fail at the piece count
+    std::vector<engine::Position> endgames, middlegames;
+    for (const char *fen : {"8/8/8/8/8/8/4P3/4K2k w - - 0 1", "8/8/8/3k4/8/8/8/KR6 b - - 0 1",
+                            "7k/8/8/8/8/8/8/KBN5 w - - 0 1", "8/8/8/8/8/3K4/3Q4/k7 w - - 0 1"})
+        endgames.emplace_back(fen);
+    for (std::string fen : {std::string(engine::START_FEN), std::string("r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4")})
+        middlegames.emplace_back(fen);
+
+    for (auto *positions : {&endgames, &middlegames})
+    {
+        const int rounds = 1000000;
+        int hits = 0;
+        engine::Eval score;
+        begin = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; round++)
+            hits += engine::bitbase::probe((*positions)[round % positions->size()], score);
+        end = std::chrono::steady_clock::now();
+        std::cout << (positions == &endgames ? "endgame" : "middlegame") << " probe: "
+                  << std::chrono::duration<double, std::nano>(end - begin).count() / rounds << " ns, "
+                  << hits << " hits" << std::endl;
+    }
+    engine::bitbase::clear();
+}
+
+TEST_CASE("ServerTest", "[engine]")
+{
+    engine::bitboard::init();
+    engine::zobrist::init();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::string> lines;
+    auto waitFor = [&](const std::string &prefix)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return condition.wait_for(lock, std::chrono::seconds(10), [&]()
+                                  { return std::any_of(lines.begin(), lines.end(), [&](const std::string &line)
+                                                       { return line.rfind(prefix, 0) == 0; }); });
+    };
+
+    {
+        engine::GameServer server(2, 2, 8, [&](const std::string &line)
+                                  {
+                                      std::lock_guard<std::mutex> lock(mutex);
+                                      lines.push_back(line);
+                                      condition.notify_all();
+                                  });
+        REQUIRE(server.getSessionHashSize() == 4);
+
+        // every game has its own position, and the responses carry its id
+        REQUIRE(server.processLine("a position startpos moves e2e4"));
+        REQUIRE(server.processLine("b position fen 6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1"));
+        REQUIRE(server.processLine("a go depth 4"));
+        REQUIRE(server.processLine("b go depth 4"));
+        REQUIRE(waitFor("a bestmove"));
+        REQUIRE(waitFor("b bestmove a1a8"));
+        REQUIRE(server.getSessionCount() == 2);
+
+        // the server is full, and the hash is not set by the games
+        REQUIRE(server.processLine("c isready"));
+        REQUIRE(waitFor("c info string"));
+        {
+            // the commands of a game run before processLine returns, only the searches are queued
+            std::lock_guard<std::mutex> lock(mutex);
+            REQUIRE(std::none_of(lines.begin(), lines.end(), [](const std::string &line)
+                                 { return line == "c readyok"; }));
+        }
+        REQUIRE(server.processLine("a setoption name Hash value 1024"));
+        REQUIRE(waitFor("a info string Hash"));
+        REQUIRE(server.processLine("a go perft 20"));
+        REQUIRE(waitFor("a info string perft"));
+
+        // a game that ends makes room for another one
+        REQUIRE(server.processLine("a quit"));
+        REQUIRE(server.getSessionCount() == 1);
+        REQUIRE(server.processLine("c isready"));
+        REQUIRE(waitFor("c readyok"));
+
+        // a game can end during its search
+        REQUIRE(server.processLine("b go infinite"));
+        REQUIRE(server.processLine("b quit"));
+        REQUIRE(!server.processLine("quit"));
+    }
+
+    {
+        lines.clear();
+        engine::GameServer server(1, 2, 8, [&](const std::string &line)
+                                  {
+                                      std::lock_guard<std::mutex> lock(mutex);
+                                      lines.push_back(line);
+                                      condition.notify_all();
+                                  });
+        REQUIRE(server.processLine("a setoption name Ponder value true"));
+        REQUIRE(waitFor("a info string Ponder"));
+
+        // a pondering game holds no worker, so the only one is free for the other game
+        REQUIRE(server.processLine("a position startpos moves e2e4 e7e5"));
+        REQUIRE(server.processLine("a go ponder wtime 1000 btime 1000"));
+        REQUIRE(server.processLine("b position startpos"));
+        REQUIRE(server.processLine("b go depth 4"));
+        REQUIRE(waitFor("b bestmove"));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            REQUIRE(std::none_of(lines.begin(), lines.end(), [](const std::string &line)
+                                 { return line.rfind("a bestmove", 0) == 0; }));
+        }
+
+        // the ponder hit starts the search on the clock
+        REQUIRE(server.processLine("a ponderhit"));
+        REQUIRE(waitFor("a bestmove"));
+
+        // a stop answers a waiting ponder at once
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            lines.clear();
+        }
+        REQUIRE(server.processLine("b position startpos moves e2e4"));
+        REQUIRE(server.processLine("b go ponder wtime 1000000 btime 1000000"));
+        REQUIRE(server.processLine("b stop"));
+        REQUIRE(waitFor("b bestmove"));
+        REQUIRE(!server.processLine("quit"));
+    }
+
+    {
+        lines.clear();
+        engine::GameServer server(2, 2, 8, [&](const std::string &line)
+                                  {
+                                      std::lock_guard<std::mutex> lock(mutex);
+                                      lines.push_back(line);
+                                      condition.notify_all();
+                                  });
+        auto countLines = [&](const std::string &prefix)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return std::count_if(lines.begin(), lines.end(), [&](const std::string &line)
+                                 { return line.rfind(prefix, 0) == 0; });
+        };
+
+        // a second go, or a new position, is refused while the search runs
+        REQUIRE(server.processLine("a position startpos"));
+        REQUIRE(server.processLine("a go depth 6"));
+        REQUIRE(server.processLine("a go depth 6"));
+        REQUIRE(server.processLine("a position startpos moves e2e4"));
+        REQUIRE(server.processLine("a ucinewgame"));
+        REQUIRE(waitFor("a bestmove"));
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        REQUIRE(countLines("a bestmove") == 1);
+        REQUIRE(countLines("a info string go is refused") == 1);
+        REQUIRE(countLines("a info string position is refused") == 1);
+        REQUIRE(countLines("a info string ucinewgame is refused") == 1);
+
+        // the next go is taken as soon as the bestmove is sent
+        REQUIRE(server.processLine("a position startpos moves e2e4"));
+        REQUIRE(server.processLine("a go depth 2"));
+        std::unique_lock<std::mutex> lock(mutex);
+        REQUIRE(condition.wait_for(lock, std::chrono::seconds(10), [&]()
+                                   { return std::count_if(lines.begin(), lines.end(), [](const std::string &line)
+                                                          { return line.rfind("a bestmove", 0) == 0; }) == 2; }));
+        lock.unlock();
+        REQUIRE(countLines("a info string") == 3);
+        REQUIRE(!server.processLine("quit"));
+    }
 }